@@ -0,0 +1,414 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Conversions from u8 and u16 formats where each destination component
+ * only depends on the source component at the same position, like gamma
+ * changes or type conversions, can be done with a table holding the
+ * destination component for every source value. Such conversions are
+ * found by sampling the reference conversion on pixels with all components
+ * equal, and verifying the resulting table on the test pixels. Verified
+ * tables are registered as conversions, making them available to the
+ * path search along with hand written conversions.
+ *
+ * A destination with an alpha component after those of a source without
+ * one, like R'G'B' u8 to RGBA u16, gets the alpha the reference conversion
+ * gives the first source value, as long as it is the same for the test
+ * pixels.
+ */
+
+#include "config.h"
+#include <string.h>
+#include <stdint.h>
+#include "babl-internal.h"
+#include "babl-ref-pixels.h"
+
+#define BABL_TABLE_MAX_SIZE  (1 << 20) /* bytes */
+
+typedef struct BablConversionTable
+{
+  int            components;     /* of the source */
+  int            destination_components;
+  int            source_bytes;   /* bytes per source component, 1 or 2 */
+  int            bytes_per_pixel;/* of the destination */
+  int            offset[BABL_MAX_COMPONENTS];
+  int            size[BABL_MAX_COMPONENTS];
+  int            uniform_size;   /* size of all components, or 0 if mixed */
+  unsigned char *table;          /* a destination pixel per source value */
+} BablConversionTable;
+
+/* the pairs of formats whose conversion was found not to be separable,
+ * not to be sampled again by later searches; only used while holding
+ * babl_format_mutex, like the path searches making tables */
+typedef struct RejectedPair
+{
+  const Babl *source;
+  const Babl *destination;
+} RejectedPair;
+
+static RejectedPair *rejected       = NULL;
+static int           rejected_size  = 0;  /* a power of two */
+static int           rejected_count = 0;
+
+/* the common case of components of one type, with the index computation
+ * and copy specialized per component size; an added alpha component is
+ * that of the first table entry.
+ */
+#define TABLE_LOOP(src_type, dst_type)                                     \
+  {                                                                        \
+    const src_type *s  = (const src_type *) src;                           \
+    dst_type       *d  = (dst_type *) dst;                                 \
+    const dst_type *tb = (const dst_type *) t->table;                      \
+    long            j, k;                                                  \
+                                                                           \
+    if (dcomp == ncomp)                                                    \
+      for (j = 0; j < n * ncomp; j += ncomp)                               \
+        for (c = 0; c < ncomp; c++)                                        \
+          d[j + c] = tb[s[j + c] * ncomp + c];                             \
+    else                                                                   \
+      for (j = 0, k = 0; j < n * ncomp; j += ncomp, k += dcomp)            \
+        {                                                                  \
+          for (c = 0; c < ncomp; c++)                                      \
+            d[k + c] = tb[s[j + c] * dcomp + c];                           \
+          d[k + ncomp] = tb[ncomp];                                        \
+        }                                                                  \
+  }
+
+static long
+table_process (const char *src,
+               char       *dst,
+               long        n,
+               void       *user_data)
+{
+  const BablConversionTable *t      = user_data;
+  const int                  bpp    = t->bytes_per_pixel;
+  const int                  ncomp  = t->components;
+  const int                  dcomp  = t->destination_components;
+  long                       i;
+  int                        c;
+
+  if (t->source_bytes == 1)
+    switch (t->uniform_size)
+      {
+        case 1: TABLE_LOOP (uint8_t, uint8_t);   return n;
+        case 2: TABLE_LOOP (uint8_t, uint16_t);  return n;
+        case 4: TABLE_LOOP (uint8_t, uint32_t);  return n;
+        case 8: TABLE_LOOP (uint8_t, uint64_t);  return n;
+      }
+  else
+    switch (t->uniform_size)
+      {
+        case 1: TABLE_LOOP (uint16_t, uint8_t);  return n;
+        case 2: TABLE_LOOP (uint16_t, uint16_t); return n;
+        case 4: TABLE_LOOP (uint16_t, uint32_t); return n;
+        case 8: TABLE_LOOP (uint16_t, uint64_t); return n;
+      }
+
+  for (i = 0; i < n; i++)
+    {
+      for (c = 0; c < dcomp; c++)
+        {
+          unsigned int         v     = c >= ncomp ? 0 :
+                                       t->source_bytes == 1 ?
+                                         ((const uint8_t *) src)[c] :
+                                         ((const uint16_t *) src)[c];
+          const unsigned char *entry = t->table + v * bpp + t->offset[c];
+          char                *out   = dst + t->offset[c];
+
+          switch (t->size[c])
+            {
+              case 1: memcpy (out, entry, 1); break;
+              case 2: memcpy (out, entry, 2); break;
+              case 4: memcpy (out, entry, 4); break;
+              case 8: memcpy (out, entry, 8); break;
+              default: memcpy (out, entry, t->size[c]); break;
+            }
+        }
+      src += ncomp * t->source_bytes;
+      dst += bpp;
+    }
+  return n;
+}
+
+static int
+table_destroy (void *data)
+{
+  Babl *babl = data;
+  BablConversionTable *t = babl->conversion.data;
+
+  if (t)
+    {
+      babl_free (t->table);
+      babl_free (t);
+    }
+  babl->conversion.data = NULL;
+  return 0;
+}
+
+static int
+table_eligible (const Babl *source,
+                const Babl *destination)
+{
+  const Babl *type;
+  int         i;
+
+  if (source->class_type != BABL_FORMAT ||
+      destination->class_type != BABL_FORMAT ||
+      source == destination)
+    return 0;
+  if (source->format.planar || destination->format.planar ||
+      source->format.palette || destination->format.palette)
+    return 0;
+  if (source->format.components != destination->format.components)
+    {
+      /* only an alpha component added at the end is supported */
+      const int components = source->format.components;
+
+      if (destination->format.components != components + 1 ||
+          !destination->format.component[components]->alpha)
+        return 0;
+      for (i = 0; i < components; i++)
+        if (source->format.component[i]->alpha)
+          return 0;
+    }
+
+  type = (const Babl *) source->format.type[0];
+  if (type != babl_type_from_id (BABL_U8) &&
+      type != babl_type_from_id (BABL_U16))
+    return 0;
+  for (i = 1; i < source->format.components; i++)
+    if ((const Babl *) source->format.type[i] != type)
+      return 0;
+
+  if ((1 << type->type.bits) * destination->format.bytes_per_pixel >
+      BABL_TABLE_MAX_SIZE)
+    return 0;
+
+  /* hand written conversions are assumed to be better */
+  if (babl_conversion_find (source, destination))
+    return 0;
+
+  return 1;
+}
+
+static RejectedPair *
+rejected_slot (RejectedPair *pairs,
+               int           size,
+               const Babl   *source,
+               const Babl   *destination)
+{
+  size_t       key = (size_t) source * 31 + (size_t) destination;
+  unsigned int i;
+
+  key ^= key >> 15;
+  key *= 0x2c1b3c6d;
+  key ^= key >> 12;
+  i = (unsigned int) key & (size - 1);
+
+  while (pairs[i].source &&
+         (pairs[i].source != source || pairs[i].destination != destination))
+    i = (i + 1) & (size - 1);
+  return &pairs[i];
+}
+
+static int
+table_rejected (const Babl *source,
+                const Babl *destination)
+{
+  return rejected_count &&
+         rejected_slot (rejected, rejected_size,
+                        source, destination)->source != NULL;
+}
+
+static void
+table_reject (const Babl *source,
+              const Babl *destination)
+{
+  RejectedPair *slot;
+
+  if ((rejected_count + 1) * 2 > rejected_size)
+    {
+      RejectedPair *old      = rejected;
+      int           old_size = rejected_size;
+      int           i;
+
+      rejected_size = rejected_size ? rejected_size * 2 : 64;
+      rejected      = babl_calloc (rejected_size, sizeof (RejectedPair));
+      for (i = 0; i < old_size; i++)
+        if (old[i].source)
+          *rejected_slot (rejected, rejected_size,
+                          old[i].source, old[i].destination) = old[i];
+      if (old)
+        babl_free (old);
+    }
+
+  slot = rejected_slot (rejected, rejected_size, source, destination);
+  if (!slot->source)
+    {
+      slot->source      = source;
+      slot->destination = destination;
+      rejected_count++;
+    }
+}
+
+static BablConversionTable *
+table_new (const Babl *source,
+           const Babl *destination)
+{
+  BablConversionTable *t = babl_calloc (1, sizeof (BablConversionTable));
+  int                  entries;
+  int                  offset = 0;
+  int                  i, c;
+  void                *diagonal;
+
+  t->components             = source->format.components;
+  t->destination_components = destination->format.components;
+  t->source_bytes           = source->format.type[0]->bits / 8;
+  t->bytes_per_pixel        = destination->format.bytes_per_pixel;
+  for (c = 0; c < t->destination_components; c++)
+    {
+      t->offset[c] = offset;
+      t->size[c]   = destination->format.type[c]->bits / 8;
+      offset      += t->size[c];
+    }
+  t->uniform_size = t->size[0];
+  for (c = 1; c < t->destination_components; c++)
+    if (t->size[c] != t->size[0])
+      t->uniform_size = 0;
+
+  entries  = 1 << (t->source_bytes * 8);
+  diagonal = babl_malloc (entries * source->format.bytes_per_pixel);
+  t->table = babl_malloc (entries * t->bytes_per_pixel);
+
+  for (i = 0; i < entries; i++)
+    for (c = 0; c < t->components; c++)
+      {
+        if (t->source_bytes == 1)
+          ((uint8_t *) diagonal)[i * t->components + c] = i;
+        else
+          ((uint16_t *) diagonal)[i * t->components + c] = i;
+      }
+
+  babl_fish_reference_process (babl_fish_reference (source, destination),
+                               diagonal, (char *) t->table, entries);
+  babl_free (diagonal);
+  return t;
+}
+
+/* returns the error of the table relative to the reference conversion,
+ * non separable conversions yield large errors.
+ */
+static double
+table_error (BablConversionTable *t,
+             const Babl          *source,
+             const Babl          *destination)
+{
+  const Babl   *fmt_rgba_double = babl_format_new (babl_model ("RGBA"),
+                                                   babl_type ("double"),
+                                                   babl_component ("R"),
+                                                   babl_component ("G"),
+                                                   babl_component ("B"),
+                                                   babl_component ("A"),
+                                                   NULL);
+  const int     test_pixels = babl_get_num_path_test_pixels ();
+  const Babl   *fish_destination_to_rgba;
+  const void   *src;
+  const void   *ref_dst;
+  void         *dst;
+  double       *dst_rgba_double;
+  const double *ref_dst_rgba_double;
+  double        error;
+
+  fish_destination_to_rgba = babl_fish_reference (destination, fmt_rgba_double);
+
+  /* the test pixels and their reference conversion are shared with the
+   * path searches */
+  src     = babl_path_test_buffer (source);
+  ref_dst = babl_path_reference (source, destination,
+                                 &ref_dst_rgba_double, NULL);
+
+  dst             = babl_calloc (test_pixels, destination->format.bytes_per_pixel);
+  dst_rgba_double = babl_calloc (test_pixels, 4 * sizeof (double));
+
+  table_process (src, dst, test_pixels, t);
+
+  if (!memcmp (dst, ref_dst,
+               (long) test_pixels * destination->format.bytes_per_pixel))
+    {
+      error = 0.0;
+    }
+  else
+    {
+      babl_fish_reference_process (fish_destination_to_rgba,
+                                   dst, (char *) dst_rgba_double, test_pixels);
+      error = babl_rel_avg_error (dst_rgba_double, ref_dst_rgba_double,
+                                  test_pixels * 4);
+    }
+
+  babl_free (dst);
+  babl_free (dst_rgba_double);
+  return error;
+}
+
+/* registers a table conversion from source to destination if the
+ * conversion between them is separable per component, returns it or NULL.
+ */
+Babl *
+babl_conversion_table (const Babl *source,
+                       const Babl *destination)
+{
+  BablConversionTable *t;
+  Babl                *conversion;
+
+  if (!table_eligible (source, destination) ||
+      table_rejected (source, destination))
+    return NULL;
+
+  t = table_new (source, destination);
+  if (table_error (t, source, destination) > babl_legal_error ())
+    {
+      babl_free (t->table);
+      babl_free (t);
+      table_reject (source, destination);
+      return NULL;
+    }
+
+  conversion = (Babl *) babl_conversion_new (source, destination,
+                                             "linear", table_process,
+                                             "data", t,
+                                             NULL);
+  babl_set_destructor (conversion, table_destroy);
+  return conversion;
+}
+
+/* tables are made for the pairs of formats this process uses, they are
+ * not conversions another process is bound to have */
+int
+babl_conversion_is_table (const Babl *conversion)
+{
+  return conversion->conversion.function.linear == table_process;
+}
+
+void
+babl_conversion_table_deinit (void)
+{
+  if (rejected)
+    babl_free (rejected);
+  rejected       = NULL;
+  rejected_size  = 0;
+  rejected_count = 0;
+}
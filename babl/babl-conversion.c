@@ -457,18 +457,16 @@ babl_conversion_error (BablConversion *conversion)
   double  error       = 0.0;
   long    ticks_start = 0;
   long    ticks_end   = 0;
+  int     palette;
 
   const int test_pixels = babl_get_num_conversion_test_pixels ();
-  const double *test = babl_get_conversion_test_pixels ();
 
-  void   *source;
-  void   *destination;
-  double *destination_rgba_double;
-  void   *ref_destination;
-  double *ref_destination_rgba_double;
+  const void   *source;
+  void         *destination;
+  double       *destination_rgba_double;
+  const void   *ref_destination;
+  const double *ref_destination_rgba_double;
 
-  Babl   *fish_rgba_to_source;
-  Babl   *fish_reference;
   Babl   *fish_destination_to_rgba;
 
   if (!conversion)
@@ -478,12 +476,12 @@ babl_conversion_error (BablConversion *conversion)
     {
       return conversion->error;
     }
+  if (babl_snapshot_conversion (conversion))
+    return conversion->error;
 
   fmt_source      = BABL (conversion->source);
   fmt_destination = BABL (conversion->destination);
 
-  fish_rgba_to_source      = babl_fish_reference (fmt_rgba_double, fmt_source);
-  fish_reference           = babl_fish_reference (fmt_source, fmt_destination);
   fish_destination_to_rgba = babl_fish_reference (fmt_destination, fmt_rgba_double);
 
   if (fmt_source == fmt_destination)
@@ -502,45 +500,47 @@ babl_conversion_error (BablConversion *conversion)
       conversion->error = 0.000042;
     }
 
-  source                      = babl_calloc (test_pixels, fmt_source->format.bytes_per_pixel);
-  destination                 = babl_calloc (test_pixels, fmt_destination->format.bytes_per_pixel);
-  ref_destination             = babl_calloc (test_pixels, fmt_destination->format.bytes_per_pixel);
-  destination_rgba_double     = babl_calloc (test_pixels, fmt_rgba_double->format.bytes_per_pixel);
-  ref_destination_rgba_double = babl_calloc (test_pixels, fmt_rgba_double->format.bytes_per_pixel);
+  /* the test pixels in the source format and the reference conversion of
+   * them are shared by the measurements, those of palette formats can
+   * change while they are used */
+  palette = babl_format_is_palette (fmt_source) ||
+            babl_format_is_palette (fmt_destination);
+  if (palette)
+    babl_mutex_lock (babl_format_mutex);
+  source          = babl_conversion_test_buffer (fmt_source);
+  ref_destination = babl_conversion_reference (fmt_source, fmt_destination,
+                                               &ref_destination_rgba_double);
 
-  babl_process (fish_rgba_to_source,
-                test, source, test_pixels);
+  destination             = babl_calloc (test_pixels, fmt_destination->format.bytes_per_pixel);
+  destination_rgba_double = babl_calloc (test_pixels, fmt_rgba_double->format.bytes_per_pixel);
 
   ticks_start = babl_ticks ();
-  babl_process (babl_fish_simple (conversion),
-                source, destination, test_pixels);
+  babl_conversion_process (BABL (conversion),
+                           source, destination, test_pixels);
   ticks_end = babl_ticks ();
 
-  babl_process (fish_reference,
-                source, ref_destination, test_pixels);
-
-  babl_process (fish_destination_to_rgba,
-                ref_destination, ref_destination_rgba_double, test_pixels);
-  babl_process (fish_destination_to_rgba,
-                destination, destination_rgba_double, test_pixels);
-
-  error = babl_rel_avg_error (destination_rgba_double,
-                              ref_destination_rgba_double,
-                              test_pixels * 4);
-
-  fish_rgba_to_source->fish.processings--;
-  fish_reference->fish.processings--;
-  fish_destination_to_rgba->fish.processings -= 2;
-
-  fish_rgba_to_source->fish.pixels      -= test_pixels;
-  fish_reference->fish.pixels           -= test_pixels;
-  fish_destination_to_rgba->fish.pixels -= 2 * test_pixels;
+  if (!memcmp (destination, ref_destination,
+               (long) test_pixels * fmt_destination->format.bytes_per_pixel))
+    {
+      error = 0.0;
+    }
+  else
+    {
+      /* not counted in the stats of the reference fish, which measurements
+       * on other threads share */
+      babl_fish_reference_process (fish_destination_to_rgba,
+                                   destination,
+                                   (char *) destination_rgba_double,
+                                   test_pixels);
+      error = babl_rel_avg_error (destination_rgba_double,
+                                  ref_destination_rgba_double,
+                                  test_pixels * 4);
+    }
+  if (palette)
+    babl_mutex_unlock (babl_format_mutex);
 
-  babl_free (source);
   babl_free (destination);
   babl_free (destination_rgba_double);
-  babl_free (ref_destination);
-  babl_free (ref_destination_rgba_double);
 
   conversion->error = error;
   conversion->cost  = babl_process_cost (ticks_start, ticks_end);
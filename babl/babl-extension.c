@@ -31,6 +31,7 @@
 #include "babl-internal.h"
 #include "babl-db.h"
 #include "babl-base.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
 
@@ -114,10 +115,13 @@ babl_extension_base (void)
   return babl;
 }
 
+static void lazy_destroy (void);
+
 void babl_extension_deinit (void)
 {
   babl_free (babl_quiet);
   babl_quiet = NULL;
+  lazy_destroy ();
 }
 
 #ifdef BABL_DYNAMIC_EXTENSIONS
@@ -188,8 +192,479 @@ load_failed (Babl *babl)
   return NULL;
 }
 
+static Babl *
+babl_extension_load (const char *path);
+
+/* An extension with an up to date manifest next to it, listing the types,
+ * components, models, formats and conversions it registers, is not loaded
+ * by babl_init (). It is loaded when a name lookup misses something it
+ * provides, or when a path search could use one of its conversions.
+ *
+ * A manifest starts with a line holding its version and the cpu features
+ * present when it was written, followed by a line per item, its class and
+ * name separated by a tab, and for format conversions the names of their
+ * source and destination. A line "eager" marks extensions registering
+ * things that cannot be told from names, which are always loaded.
+ */
+
+#define BABL_MANIFEST_SUFFIX   ".manifest"
+#define BABL_MANIFEST_VERSION  1
+
+typedef struct LazyEntry
+{
+  char *klass;
+  char *name;        /* the source format for conversions */
+  char *destination; /* the destination format for conversions */
+  int   extension;   /* index in lazy.paths */
+} LazyEntry;
+
+static struct
+{
+  char     **paths;      /* of extensions, NULL once loaded */
+  int        extensions;
+  int        pending;    /* extensions not loaded yet */
+  LazyEntry *entries;
+  int        count;
+  int        size;
+} lazy = { NULL, 0, 0, NULL, 0, 0 };
+
+/* returns 0 when manifests are ignored, 1 when they are used and 2 when
+ * they are written for all extensions, which are then all loaded */
+static int
+manifest_mode (void)
+{
+  const char *env = getenv ("BABL_MANIFESTS");
+
+  if (!env || !env[0])
+    return 1;
+  if (!strcmp (env, "write"))
+    return 2;
+  return atoi (env) != 0;
+}
+
+static char *
+manifest_path (const char *path)
+{
+  char  *manifest = babl_strdup (path);
+  char  *extension = strrchr (manifest, '.');
+
+  if (extension && !strcmp (extension, SHREXT))
+    *extension = '\0';
+  return babl_strcat (manifest, BABL_MANIFEST_SUFFIX);
+}
+
+static void
+lazy_add (const char *klass,
+          const char *name,
+          const char *destination,
+          int         extension)
+{
+  LazyEntry *entry;
+
+  if (lazy.count == lazy.size)
+    {
+      lazy.size    = lazy.size ? lazy.size * 2 : 256;
+      lazy.entries = babl_realloc (lazy.entries,
+                                   sizeof (LazyEntry) * lazy.size);
+    }
+  entry              = &lazy.entries[lazy.count++];
+  entry->klass       = babl_strdup (klass);
+  entry->name        = babl_strdup (name);
+  entry->destination = destination ? babl_strdup (destination) : NULL;
+  entry->extension   = extension;
+}
+
+static void
+lazy_truncate (int count)
+{
+  while (lazy.count > count)
+    {
+      LazyEntry *entry = &lazy.entries[--lazy.count];
+
+      babl_free (entry->klass);
+      babl_free (entry->name);
+      if (entry->destination)
+        babl_free (entry->destination);
+    }
+}
+
+static void
+lazy_destroy (void)
+{
+  int i;
+
+  lazy_truncate (0);
+  for (i = 0; i < lazy.extensions; i++)
+    if (lazy.paths[i])
+      babl_free (lazy.paths[i]);
+  if (lazy.entries)
+    babl_free (lazy.entries);
+  if (lazy.paths)
+    babl_free (lazy.paths);
+  memset (&lazy, 0, sizeof (lazy));
+}
+
+/* registers the extension at path for loading on demand, returns 0 when it
+ * has no usable manifest and has to be loaded now */
+static int
+lazy_register (const char *path)
+{
+  char         *manifest = manifest_path (path);
+  FILE         *file;
+  struct stat   st_extension;
+  struct stat   st_manifest;
+  char          line[1024];
+  int           version  = 0;
+  unsigned int  cpu      = 0;
+  int           count    = lazy.count;
+  int           ok       = 0;
+
+  if (stat (path, &st_extension) ||
+      stat (manifest, &st_manifest) ||
+      st_manifest.st_mtime < st_extension.st_mtime ||
+      !(file = fopen (manifest, "r")))
+    {
+      babl_free (manifest);
+      return 0;
+    }
+  babl_free (manifest);
+
+  if (fgets (line, sizeof (line), file) &&
+      sscanf (line, "babl-manifest %i %x", &version, &cpu) == 2 &&
+      version == BABL_MANIFEST_VERSION &&
+      cpu == (unsigned int) babl_cpu_accel_get_support ())
+    {
+      ok = 1;
+      while (ok && fgets (line, sizeof (line), file))
+        {
+          char *name;
+          char *destination;
+
+          line[strcspn (line, "\r\n")] = '\0';
+          if (!strcmp (line, "eager") || !(name = strchr (line, '\t')))
+            {
+              ok = 0;
+              break;
+            }
+          *name++ = '\0';
+          if ((destination = strchr (name, '\t')))
+            *destination++ = '\0';
+          lazy_add (line, name, destination, lazy.extensions);
+        }
+    }
+  fclose (file);
+
+  if (!ok)
+    {
+      lazy_truncate (count);
+      return 0;
+    }
+
+  lazy.paths = babl_realloc (lazy.paths,
+                             sizeof (char *) * (lazy.extensions + 1));
+  lazy.paths[lazy.extensions++] = babl_strdup (path);
+  lazy.pending++;
+  return 1;
+}
+
+static void
+lazy_load (int extension)
+{
+  Babl *extender = babl_extender ();
+  char *path     = lazy.paths[extension];
+
+  if (!path)
+    return;
+  /* marked as loaded first, its init () may look up names it provides */
+  lazy.paths[extension] = NULL;
+  lazy.pending--;
+  babl_extension_load (path);
+  babl_free (path);
+  babl_set_extender (extender);
+}
+
+/* extensions loaded on demand register under babl_format_mutex, keeping
+ * them from changing the formats and conversions of a path search in
+ * another thread */
+void
+babl_extension_load_pending (void)
+{
+  int i;
+
+  if (!lazy.pending)
+    return;
+  babl_mutex_lock (babl_format_mutex);
+  for (i = 0; i < lazy.extensions && lazy.pending; i++)
+    lazy_load (i);
+  babl_mutex_unlock (babl_format_mutex);
+}
+
+int
+babl_extension_load_providing (const char *klass,
+                               const char *name)
+{
+  int found = 0;
+  int i;
+
+  if (!lazy.pending)
+    return 0;
+  babl_mutex_lock (babl_format_mutex);
+  for (i = 0; i < lazy.count && lazy.pending && !found; i++)
+    {
+      LazyEntry *entry = &lazy.entries[i];
+
+      if (lazy.paths[entry->extension] &&
+          !entry->destination &&
+          !strcmp (entry->name, name) &&
+          !strcmp (entry->klass, klass))
+        {
+          lazy_load (entry->extension);
+          found = 1;
+        }
+    }
+  babl_mutex_unlock (babl_format_mutex);
+  return found;
+}
+
+/* format conversions, of both loaded and pending extensions, by name */
+typedef struct PathEdge
+{
+  const char *source;
+  const char *destination;
+  int         extension;  /* -1 when loaded */
+} PathEdge;
+
+typedef struct PathGraph
+{
+  PathEdge    *edges;
+  int          count;
+  const char **nodes;     /* names reached, with their distance */
+  int         *distance;
+  int          reached;
+} PathGraph;
+
+static int
+collect_edge (Babl *babl,
+              void *data)
+{
+  PathGraph *graph = data;
+
+  if (babl->conversion.source->class_type == BABL_FORMAT &&
+      babl->conversion.destination->class_type == BABL_FORMAT)
+    {
+      PathEdge *edge    = &graph->edges[graph->count++];
+      edge->source      = babl->conversion.source->instance.name;
+      edge->destination = babl->conversion.destination->instance.name;
+      edge->extension   = -1;
+    }
+  return 0;
+}
+
+static int
+node_distance (PathGraph  *graph,
+               const char *name)
+{
+  int i;
+
+  for (i = 0; i < graph->reached; i++)
+    if (!strcmp (graph->nodes[i], name))
+      return graph->distance[i];
+  return -1;
+}
+
+/* computes the number of conversions from start, or to start when
+ * backwards, of the formats reachable in less than max_length */
+static void
+reach (PathGraph  *graph,
+       const char *start,
+       int         backwards,
+       int         max_length)
+{
+  int level;
+  int i;
+
+  graph->reached     = 1;
+  graph->nodes[0]    = start;
+  graph->distance[0] = 0;
+
+  for (level = 0; level < max_length - 1; level++)
+    for (i = 0; i < graph->count; i++)
+      {
+        const char *from = backwards ? graph->edges[i].destination :
+                                       graph->edges[i].source;
+        const char *to   = backwards ? graph->edges[i].source :
+                                       graph->edges[i].destination;
+
+        if (node_distance (graph, from) == level &&
+            node_distance (graph, to) < 0)
+          {
+            graph->nodes[graph->reached]      = to;
+            graph->distance[graph->reached++] = level + 1;
+          }
+      }
+}
+
+/* loads the pending extensions with conversions that can be part of a
+ * path from source to destination of at most max_length conversions,
+ * called by path searches holding babl_format_mutex */
+void
+babl_extension_load_for_path (const Babl *source,
+                              const Babl *destination,
+                              int         max_length)
+{
+  PathGraph  graph;
+  int       *from_source;
+  int       *to_destination;
+  int        size;
+  int        i;
+
+  if (!lazy.pending ||
+      source->class_type != BABL_FORMAT ||
+      destination->class_type != BABL_FORMAT)
+    return;
+
+  size         = babl_db_count (babl_conversion_db ()) + lazy.count;
+  graph.edges  = babl_malloc (sizeof (PathEdge) * size);
+  graph.count  = 0;
+  babl_db_each (babl_conversion_db (), collect_edge, &graph);
+  for (i = 0; i < lazy.count; i++)
+    if (lazy.entries[i].destination &&
+        lazy.paths[lazy.entries[i].extension])
+      {
+        PathEdge *edge    = &graph.edges[graph.count++];
+        edge->source      = lazy.entries[i].name;
+        edge->destination = lazy.entries[i].destination;
+        edge->extension   = lazy.entries[i].extension;
+      }
+
+  graph.nodes    = babl_malloc (sizeof (char *) * (graph.count * 2 + 1));
+  graph.distance = babl_malloc (sizeof (int) * (graph.count * 2 + 1));
+  from_source    = babl_calloc (sizeof (int), graph.count);
+  to_destination = babl_calloc (sizeof (int), graph.count);
+
+  reach (&graph, source->instance.name, 0, max_length);
+  for (i = 0; i < graph.count; i++)
+    from_source[i] = node_distance (&graph, graph.edges[i].source);
+  reach (&graph, destination->instance.name, 1, max_length);
+  for (i = 0; i < graph.count; i++)
+    to_destination[i] = node_distance (&graph, graph.edges[i].destination);
+
+  for (i = 0; i < graph.count; i++)
+    if (graph.edges[i].extension >= 0 &&
+        from_source[i] >= 0 && to_destination[i] >= 0 &&
+        from_source[i] + 1 + to_destination[i] <= max_length)
+      lazy_load (graph.edges[i].extension);
+
+  babl_free (from_source);
+  babl_free (to_destination);
+  babl_free (graph.nodes);
+  babl_free (graph.distance);
+  babl_free (graph.edges);
+}
+
+typedef struct ManifestWriter
+{
+  FILE       *file;
+  Babl       *extension;
+  const char *klass;
+  int         eager;
+} ManifestWriter;
+
+static int
+write_item (Babl *babl,
+            void *data)
+{
+  ManifestWriter *writer = data;
+
+  if (babl->instance.creator == writer->extension)
+    fprintf (writer->file, "%s\t%s\n", writer->klass, babl->instance.name);
+  return 0;
+}
+
+static int
+write_conversion (Babl *babl,
+                  void *data)
+{
+  ManifestWriter *writer      = data;
+  const Babl     *source      = babl->conversion.source;
+  const Babl     *destination = babl->conversion.destination;
+
+  if (babl->instance.creator != writer->extension)
+    return 0;
+  if (source->class_type == BABL_FORMAT &&
+      destination->class_type == BABL_FORMAT)
+    fprintf (writer->file, "conversion\t%s\t%s\n",
+             source->instance.name, destination->instance.name);
+  /* conversions between models or types of others change the reference
+   * conversions without a name to look up */
+  else if (source->instance.creator != writer->extension &&
+           destination->instance.creator != writer->extension)
+    writer->eager = 1;
+  return 0;
+}
+
+static int
+write_manifest (Babl *babl,
+                void *data)
+{
+  ManifestWriter  writer;
+  char           *path;
+
+  if (!babl->extension.dl_handle)
+    return 0;
+
+  path = manifest_path (babl->instance.name);
+  writer.file      = fopen (path, "w");
+  writer.extension = babl;
+  writer.eager     = 0;
+  if (!writer.file)
+    {
+      babl_log ("unable to write %s", path);
+      babl_free (path);
+      return 0;
+    }
+  babl_free (path);
+
+  fprintf (writer.file, "babl-manifest %i %x\n", BABL_MANIFEST_VERSION,
+           (unsigned int) babl_cpu_accel_get_support ());
+  writer.klass = "type";
+  babl_db_each (babl_type_db (), write_item, &writer);
+  writer.klass = "component";
+  babl_db_each (babl_component_db (), write_item, &writer);
+  writer.klass = "model";
+  babl_db_each (babl_model_db (), write_item, &writer);
+  writer.klass = "format";
+  babl_db_each (babl_format_db (), write_item, &writer);
+  babl_db_each (babl_conversion_db (), write_conversion, &writer);
+  if (writer.eager)
+    fprintf (writer.file, "eager\n");
+  fclose (writer.file);
+  return 0;
+}
+
+static Babl *
+extension_init (const char              *path,
+                HLIB                     dl_handle,
+                BablExtensionInitFunc    init,
+                BablExtensionDestroyFunc destroy);
+
+static Babl *
+extension_load (const char *path);
+
+/* loads the extension at path, recording it as a startup phase */
 static Babl *
 babl_extension_load (const char *path)
+{
+  Babl *babl;
+
+  babl_startup_phase_begin (path);
+  babl = extension_load (path);
+  babl_startup_phase_end ();
+  return babl;
+}
+
+static Babl *
+extension_load (const char *path)
 {
   Babl *babl = NULL;
   /* do the actual loading thing */
@@ -213,15 +688,25 @@ babl_extension_load (const char *path)
     }
 
   destroy = (BablExtensionDestroyFunc) dlsym (dl_handle, "destroy");
-  babl    = extension_new (path,
-                           dl_handle,
-                           destroy);
+  return extension_init (path, dl_handle, init, destroy);
+}
+
+static Babl *
+extension_init (const char              *path,
+                HLIB                     dl_handle,
+                BablExtensionInitFunc    init,
+                BablExtensionDestroyFunc destroy)
+{
+  Babl *babl = extension_new (path,
+                              dl_handle,
+                              destroy);
 
   babl_set_extender (babl);
   if (init ())
     {
       babl_log ("babl_extension_init() in extension '%s' failed (return!=0)", path);
-      dlclose (dl_handle);
+      if (dl_handle)
+        dlclose (dl_handle);
       return load_failed (babl);
     }
 
@@ -237,6 +722,79 @@ babl_extension_load (const char *path)
     }
 }
 
+#ifdef BABL_BUILTIN_EXTENSIONS
+
+int babl_builtin_cairo_init (void);
+int babl_builtin_CIE_init (void);
+int babl_builtin_gegl_fixups_init (void);
+int babl_builtin_gggl_lies_init (void);
+int babl_builtin_gggl_init (void);
+int babl_builtin_gimp_8bit_init (void);
+int babl_builtin_grey_init (void);
+int babl_builtin_float_init (void);
+int babl_builtin_fast_float_init (void);
+int babl_builtin_naive_CMYK_init (void);
+int babl_builtin_HSL_init (void);
+int babl_builtin_HSV_init (void);
+int babl_builtin_simple_init (void);
+int babl_builtin_sse2_float_init (void);
+int babl_builtin_sse2_int8_init (void);
+int babl_builtin_sse2_int16_init (void);
+int babl_builtin_two_table_init (void);
+int babl_builtin_ycbcr_init (void);
+
+static const struct
+{
+  const char            *name;
+  BablExtensionInitFunc  init;
+} builtin_extensions[] =
+{
+  { "cairo",       babl_builtin_cairo_init },
+  { "CIE",         babl_builtin_CIE_init },
+  { "gegl-fixups", babl_builtin_gegl_fixups_init },
+  { "gggl-lies",   babl_builtin_gggl_lies_init },
+  { "gggl",        babl_builtin_gggl_init },
+  { "gimp-8bit",   babl_builtin_gimp_8bit_init },
+  { "grey",        babl_builtin_grey_init },
+  { "float",       babl_builtin_float_init },
+  { "fast-float",  babl_builtin_fast_float_init },
+  { "naive-CMYK",  babl_builtin_naive_CMYK_init },
+  { "HSL",         babl_builtin_HSL_init },
+  { "HSV",         babl_builtin_HSV_init },
+  { "simple",      babl_builtin_simple_init },
+  { "sse2-float",  babl_builtin_sse2_float_init },
+  { "sse2-int8",   babl_builtin_sse2_int8_init },
+  { "sse2-int16",  babl_builtin_sse2_int16_init },
+  { "two-table",   babl_builtin_two_table_init },
+  { "ycbcr",       babl_builtin_ycbcr_init },
+};
+
+/* registers the extensions built into libbabl. They are named like the
+ * modules they replace, giving their conversions the same names, and the
+ * same costs in a BABL_PATH_COSTS file, as in a build loading modules.
+ */
+void
+babl_extension_load_builtin (void)
+{
+  int i;
+
+  for (i = 0; i < (int) (sizeof (builtin_extensions) /
+                         sizeof (builtin_extensions[0])); i++)
+    {
+      char *path = NULL;
+
+      path = babl_strcat (path, "builtin" BABL_DIR_SEPARATOR);
+      path = babl_strcat (path, builtin_extensions[i].name);
+      path = babl_strcat (path, SHREXT);
+      babl_startup_phase_begin (path);
+      extension_init (path, NULL, builtin_extensions[i].init, NULL);
+      babl_startup_phase_end ();
+      babl_free (path);
+    }
+}
+
+#endif
+
 static void
 babl_extension_load_dir (const char *base_path)
 {
@@ -263,7 +821,8 @@ babl_extension_load_dir (const char *base_path)
               if ((extension = strrchr (dentry->d_name, '.')) != NULL &&
                   !strcmp (extension, SHREXT))
                 {
-                  babl_extension_load (path);
+                  if (manifest_mode () != 1 || !lazy_register (path))
+                    babl_extension_load (path);
                 }
 
               babl_free (path);
@@ -347,6 +906,9 @@ babl_extension_load_dir_list (const char *dir_list)
         }
     }
   babl_free (path);
+
+  if (manifest_mode () == 2)
+    babl_db_each (db, write_manifest, NULL);
 }
 
 #endif
@@ -29,6 +29,13 @@ BABL_CLASS_DECLARE (extension);
 
 const  Babl * babl_extension               (const char *name);
 void          babl_extension_load_dir_list (const char *dir_list);
+void          babl_extension_load_builtin  (void);
+void          babl_extension_load_pending  (void);
+int           babl_extension_load_providing (const char *klass,
+                                             const char *name);
+void          babl_extension_load_for_path (const Babl *source,
+                                            const Babl *destination,
+                                            int         max_length);
 
 typedef struct
 {
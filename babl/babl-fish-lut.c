@@ -0,0 +1,586 @@
+/* babl - dynamically extendable universal pixel fish library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <string.h>
+#include "babl-internal.h"
+#include "babl-ref-pixels.h"
+
+#define BABL_LUT_GRID              33
+#define BABL_LUT_CHUNK             256
+#define BABL_LUT_MARGIN            0.125 /* of the range of float sources,
+                                            for colors out of gamut */
+#define BABL_MAX_COST_VALUE        2000000
+
+#ifndef MIN
+#define MIN(a, b) (((a) > (b)) ? (b) : (a))
+#endif
+
+static char *
+create_name (char       *buf,
+             const Babl *source,
+             const Babl *destination,
+             double      tolerance)
+{
+  /* fish names are intentionally kept short */
+  if (tolerance > 0.0)
+    snprintf (buf, 1024, "lut %p %p %g", source, destination, tolerance);
+  else
+    snprintf (buf, 1024, "lut %p %p", source, destination);
+  return buf;
+}
+
+typedef struct FloatFormatMatch {
+  const Babl *format;
+  const Babl *match;
+} FloatFormatMatch;
+
+static int
+is_float_format_of (const Babl *babl,
+                    const Babl *format)
+{
+  int i;
+
+  if (babl->format.model != format->format.model ||
+      babl->format.components != format->format.components ||
+      babl->format.planar || babl->format.palette)
+    return 0;
+
+  for (i = 0; i < format->format.components; i++)
+    if (babl->format.component[i] != format->format.component[i] ||
+        (const Babl *) babl->format.type[i] != babl_type_from_id (BABL_FLOAT))
+      return 0;
+  return 1;
+}
+
+static int
+match_float_format (Babl *babl,
+                    void *data)
+{
+  FloatFormatMatch *ffm = data;
+
+  if (!is_float_format_of (babl, ffm->format))
+    return 0;
+  ffm->match = babl;
+  return 1;
+}
+
+/* returns a registered float format with the model and the components of
+ * format in the same order, or NULL if there is none.
+ */
+static const Babl *
+float_format (const Babl *format)
+{
+  FloatFormatMatch ffm;
+
+  if (is_float_format_of (format, format))
+    return format;
+
+  ffm.format = format;
+  ffm.match  = NULL;
+  /* only loaded formats, enumerating would load all extensions */
+  babl_db_each (babl_format_db (), match_float_format, &ffm);
+  return ffm.match;
+}
+
+static int
+is_integer_format_of (const Babl *babl,
+                      const Babl *format)
+{
+  int i;
+
+  if (babl->format.model != format->format.model ||
+      babl->format.components != format->format.components ||
+      babl->format.planar || babl->format.palette)
+    return 0;
+
+  for (i = 0; i < format->format.components; i++)
+    {
+      const Babl *type = (const Babl *) babl->format.type[i];
+
+      if (babl->format.component[i] != format->format.component[i] ||
+          type == babl_type_from_id (BABL_FLOAT) ||
+          type == babl_type_from_id (BABL_DOUBLE) ||
+          type == babl_type_from_id (BABL_HALF))
+        return 0;
+    }
+  return 1;
+}
+
+static int
+match_integer_format (Babl *babl,
+                      void *data)
+{
+  FloatFormatMatch *ffm = data;
+
+  if (!is_integer_format_of (babl, ffm->format))
+    return 0;
+  ffm->match = babl;
+  return 1;
+}
+
+/* returns a registered integer format with the model and the components of
+ * format in the same order, or NULL if there is none.
+ */
+static const Babl *
+integer_format (const Babl *format)
+{
+  FloatFormatMatch ffm;
+
+  ffm.format = format;
+  ffm.match  = NULL;
+  babl_db_each (babl_format_db (), match_integer_format, &ffm);
+  return ffm.match;
+}
+
+/* only formats with three components of a single integer or float type
+ * are sampled, with a destination in another model, otherwise the path
+ * will be at least as fast as interpolating.
+ */
+static int
+lut_eligible (const Babl *source,
+              const Babl *destination)
+{
+  const Babl *type;
+  int         i;
+
+  if (source->class_type != BABL_FORMAT ||
+      destination->class_type != BABL_FORMAT)
+    return 0;
+  if (source->format.components != 3 ||
+      destination->format.components > 4 ||
+      source->format.planar || destination->format.planar ||
+      source->format.palette || destination->format.palette ||
+      source->format.format_n || destination->format.format_n ||
+      source->format.model == destination->format.model)
+    return 0;
+
+  type = (const Babl *) source->format.type[0];
+  if (type != babl_type_from_id (BABL_U8) &&
+      type != babl_type_from_id (BABL_U16) &&
+      type != babl_type_from_id (BABL_FLOAT))
+    return 0;
+  for (i = 1; i < 3; i++)
+    if ((const Babl *) source->format.type[i] != type)
+      return 0;
+
+  return 1;
+}
+
+static int
+babl_fish_lut_destroy (void *data)
+{
+  Babl *babl = data;
+  if (babl->fish_lut.lut)
+    babl_free (babl->fish_lut.lut);
+  babl->fish_lut.lut = NULL;
+  return 0;
+}
+
+/* interpolates inside the tetrahedron of the grid cell containing each
+ * pixel, using the four samples of the cell on the path from its lowest
+ * to its highest corner taken in order of decreasing fractions. Pixels
+ * outside of the grid are clamped to it, and marked in outside when it is
+ * not NULL, returns whether there were any.
+ */
+static int
+lut_interpolate (const BablFishLut *lut,
+                 const float       *in,
+                 float             *out,
+                 char              *outside,
+                 long               n)
+{
+  int          any      = 0;
+  const int    grid     = lut->grid;
+  const int    channels = lut->channels;
+  long         stride[3];
+  long         i;
+
+  stride[0] = (long) grid * grid * channels;
+  stride[1] = (long) grid * channels;
+  stride[2] = channels;
+
+  for (i = 0; i < n; i++)
+    {
+      const float *c0;
+      const float *c1;
+      const float *c2;
+      const float *c3;
+      float        f[3];
+      long         offset = 0;
+      int          o1, o2, o3;
+      int          c;
+
+      if (outside)
+        outside[i] = 0;
+      for (c = 0; c < 3; c++)
+        {
+          float v = (in[c] - lut->offset[c]) * lut->scale[c];
+          int   base;
+
+          if (!(v >= 0.0f && v <= grid - 1)) /* also catches NaN */
+            {
+              if (outside)
+                outside[i] = any = 1;
+              v = v > 0.0f ? grid - 1 : 0.0f;
+            }
+
+          base = (int) v;
+          if (base > grid - 2)
+            base = grid - 2;
+          f[c] = v - base;
+          offset += base * stride[c];
+        }
+
+      if (f[0] >= f[1])
+        {
+          if (f[1] >= f[2])
+            { o1 = 0; o2 = 1; o3 = 2; }
+          else if (f[0] >= f[2])
+            { o1 = 0; o2 = 2; o3 = 1; }
+          else
+            { o1 = 2; o2 = 0; o3 = 1; }
+        }
+      else
+        {
+          if (f[2] >= f[1])
+            { o1 = 2; o2 = 1; o3 = 0; }
+          else if (f[2] >= f[0])
+            { o1 = 1; o2 = 2; o3 = 0; }
+          else
+            { o1 = 1; o2 = 0; o3 = 2; }
+        }
+
+      c0 = lut->lut + offset;
+      c1 = c0 + stride[o1];
+      c2 = c1 + stride[o2];
+      c3 = c2 + stride[o3];
+
+      for (c = 0; c < channels; c++)
+        out[c] = c0[c] +
+                 f[o1] * (c1[c] - c0[c]) +
+                 f[o2] * (c2[c] - c1[c]) +
+                 f[o3] * (c3[c] - c2[c]);
+
+      in  += 3;
+      out += channels;
+    }
+  return any;
+}
+
+/* the pixels are counted in the stats of the lut fish, not in those of the
+ * fishes it passes them through */
+long
+babl_fish_lut_process (const Babl *babl,
+                       const void *source,
+                       void       *destination,
+                       long        n)
+{
+  const BablFishLut *lut        = &babl->fish_lut;
+  int                source_bpp = babl->fish.source->format.bytes_per_pixel;
+  int                dest_bpp   = babl->fish.destination->format.bytes_per_pixel;
+  float              in[BABL_LUT_CHUNK * 3];
+  float              out[BABL_LUT_CHUNK * 4];
+  char               outside[BABL_LUT_CHUNK];
+  char              *outside_p  = lut->exact ? outside : NULL;
+  long               j;
+
+  for (j = 0; j < n; j += BABL_LUT_CHUNK)
+    {
+      long        c   = MIN (n - j, BABL_LUT_CHUNK);
+      const char *src = (const char *) source + j * source_bpp;
+      const char *lut_in = src;
+      char       *dst = (char *) destination + j * dest_bpp;
+      int         any;
+      long        i;
+
+      if (lut->to_lut)
+        {
+          babl_fish_process ((Babl *) lut->to_lut, src, in, c, 0);
+          lut_in = (const char *) in;
+        }
+
+      if (lut->from_lut)
+        {
+          any = lut_interpolate (lut, (const float *) lut_in, out, outside_p, c);
+          babl_fish_process ((Babl *) lut->from_lut, out, dst, c, 0);
+        }
+      else
+        {
+          any = lut_interpolate (lut, (const float *) lut_in, (float *) dst,
+                                 outside_p, c);
+        }
+
+      /* the runs of pixels outside of the grid are converted exactly */
+      for (i = 0; any && i < c; i++)
+        if (outside[i])
+          {
+            long run = 1;
+
+            while (i + run < c && outside[i + run])
+              run++;
+            babl_fish_process ((Babl *) lut->exact, src + i * source_bpp,
+                               dst + i * dest_bpp, run, 0);
+            i += run;
+          }
+    }
+  return n;
+}
+
+/* fills the grid with samples of the exact conversion between the
+ * float formats of the source and destination models.
+ */
+static void
+lut_sample (BablFishLut *lut,
+            const Babl  *lut_source,
+            const Babl  *lut_destination)
+{
+  const Babl *fish  = babl_fish_path (lut_source, lut_destination, 0.0);
+  int         grid  = lut->grid;
+  long        count = (long) grid * grid * grid;
+  float      *in    = babl_malloc (count * 3 * sizeof (float));
+  float      *p     = in;
+  int         x, y, z;
+
+  if (!fish)
+    fish = babl_fish_reference (lut_source, lut_destination);
+
+  for (x = 0; x < grid; x++)
+    for (y = 0; y < grid; y++)
+      for (z = 0; z < grid; z++)
+        {
+          *(p++) = lut->offset[0] + x / lut->scale[0];
+          *(p++) = lut->offset[1] + y / lut->scale[1];
+          *(p++) = lut->offset[2] + z / lut->scale[2];
+        }
+
+  babl_fish_process ((Babl *) fish, in, lut->lut, count, 0);
+  babl_free (in);
+}
+
+/* the grid spans the values integer sources can encode. Float sources are
+ * unbounded, their grid spans the values an integer format of their model
+ * encodes, or 0.0 to 1.0 when there is none, widened by BABL_LUT_MARGIN on
+ * either side; pixels outside of it are converted by the exact fish.
+ */
+static void
+lut_domain (BablFishLut *lut,
+            const Babl  *source)
+{
+  unsigned char extremes[2 * 3 * 8];
+  float         range[2 * 3];
+  const Babl   *encoded;
+  int           c;
+
+  encoded = lut->to_lut ? source : integer_format (source);
+  if (encoded)
+    {
+      const Babl *float_source = lut->to_lut ? NULL : source;
+      int         bpp          = encoded->format.bytes_per_pixel;
+
+      memset (extremes, 0x00, bpp);
+      memset (extremes + bpp, 0xff, bpp);
+      if (lut->to_lut)
+        babl_fish_process ((Babl *) lut->to_lut, extremes, range, 2, 0);
+      else
+        babl_fish_reference_process (babl_fish_reference (encoded, float_source),
+                                     (char *) extremes, (char *) range, 2);
+    }
+  else
+    {
+      for (c = 0; c < 3; c++)
+        {
+          range[c]     = 0.0f;
+          range[3 + c] = 1.0f;
+        }
+    }
+
+  for (c = 0; c < 3; c++)
+    {
+      float low    = MIN (range[c], range[3 + c]);
+      float extent = range[3 + c] - range[c];
+
+      if (extent < 0.0f)
+        extent = -extent;
+      if (extent == 0.0f)
+        extent = 1.0f;
+      if (!lut->to_lut)
+        {
+          low    -= extent * BABL_LUT_MARGIN;
+          extent += extent * 2 * BABL_LUT_MARGIN;
+        }
+      lut->offset[c] = low;
+      lut->scale[c]  = (lut->grid - 1) / extent;
+    }
+}
+
+/* returns an interpolating fish if it is faster than fish_path, or the
+ * reference fish when there is no path, with an error of at most tolerance,
+ * or of babl_legal_error () when tolerance is 0.0.
+ */
+Babl *
+babl_fish_lut (const Babl *source,
+               const Babl *destination,
+               const Babl *fish_path,
+               double      tolerance)
+{
+  Babl         *babl = NULL;
+  Babl         *existing;
+  const Babl   *lut_source;
+  const Babl   *lut_destination;
+  const Babl   *fmt_rgba_double;
+  const Babl   *fish_destination_to_rgba;
+  int           num_test_pixels;
+  int           working_set;
+  int           source_bpp;
+  const void   *test_buffer;
+  void         *test_source;
+  void         *test_destination;
+  double       *destination_rgba_double;
+  const double *ref_destination_rgba_double;
+  double        cost;
+  double        competing_cost;
+  long long     reference_nsecs;
+  long long     ticks_start;
+  long long     ticks_end;
+  int           i;
+  char          name[1024];
+
+  /* the choice depends on timing, which static path costs avoid; their
+   * fish_path.cost is a sum of nanoseconds per pixel, not comparable to
+   * the cost measured below either */
+  if (babl_path_costs_static () ||
+      !lut_eligible (source, destination))
+    return NULL;
+
+  lut_source      = float_format (source);
+  lut_destination = float_format (destination);
+  if (!lut_source || !lut_destination)
+    return NULL;
+
+  create_name (name, source, destination, tolerance);
+  babl = babl_db_exist_by_name (babl_fish_db (), name);
+  if (babl)
+    {
+      /* There is an instance already registered by the required name,
+       * returning the preexistent one instead.
+       */
+      return babl;
+    }
+
+  babl = babl_calloc (1, sizeof (BablFishLut) + strlen (name) + 1);
+  babl_set_destructor (babl, babl_fish_lut_destroy);
+
+  babl->class_type         = BABL_FISH_LUT;
+  babl->instance.id        = babl_fish_get_id (source, destination);
+  babl->instance.name      = ((char *) babl) + sizeof (BablFishLut);
+  strcpy (babl->instance.name, name);
+  babl->fish.source        = source;
+  babl->fish.destination   = destination;
+  babl->fish.processings   = 0;
+  babl->fish.pixels        = 0;
+  babl->fish.error         = BABL_MAX_COST_VALUE;
+  babl->fish.tolerance     = tolerance;
+  babl->fish_lut.grid      = BABL_LUT_GRID;
+  babl->fish_lut.channels  = destination->format.components;
+  babl->fish_lut.to_lut    = lut_source != source ?
+                               babl_fish (source, lut_source) : NULL;
+  babl->fish_lut.from_lut  = lut_destination != destination ?
+                               babl_fish (lut_destination, destination) : NULL;
+  babl->fish_lut.exact     = lut_source != source ? NULL :
+                             fish_path ? fish_path :
+                               babl_fish_reference (source, destination);
+  babl->fish_lut.lut       = babl_calloc ((long) BABL_LUT_GRID * BABL_LUT_GRID *
+                                          BABL_LUT_GRID * babl->fish_lut.channels,
+                                          sizeof (float));
+
+  fmt_rgba_double = babl_format_new (babl_model ("RGBA"),
+                                     babl_type ("double"),
+                                     babl_component ("R"),
+                                     babl_component ("G"),
+                                     babl_component ("B"),
+                                     babl_component ("A"),
+                                     NULL);
+  fish_destination_to_rgba = babl_fish_reference (destination, fmt_rgba_double);
+
+  /* timed on the working set of the path search, with the test pixels
+   * repeated, and costed in the ticks of the test pixels like its paths */
+  num_test_pixels         = babl_get_num_path_test_pixels ();
+  working_set             = babl_path_working_set ();
+  source_bpp              = source->format.bytes_per_pixel;
+  test_source             = babl_malloc ((long) working_set * source_bpp);
+  test_destination        = babl_calloc (working_set,
+                                         destination->format.bytes_per_pixel);
+  destination_rgba_double = babl_calloc (num_test_pixels, 4 * sizeof (double));
+
+  test_buffer = babl_path_test_buffer (source);
+  for (i = 0; i < working_set; i += num_test_pixels)
+    memcpy ((char *) test_source + (long) i * source_bpp, test_buffer,
+            (long) MIN (num_test_pixels, working_set - i) * source_bpp);
+  babl_path_reference (source, destination,
+                       &ref_destination_rgba_double, &reference_nsecs);
+  lut_domain (&babl->fish_lut, source);
+
+  if (fish_path)
+    competing_cost = fish_path->fish_path.cost;
+  else
+    competing_cost = reference_nsecs / 1000.0 * 10 + 1;
+
+  /* the cost of interpolating does not depend on the contents of the grid,
+   * thus it is measured before spending time on sampling it.
+   */
+  ticks_start = babl_nanoticks ();
+  babl_fish_lut_process (babl, test_source, test_destination, working_set);
+  ticks_end = babl_nanoticks ();
+  cost = (ticks_end - ticks_start) / 1000.0 *
+         num_test_pixels / working_set * 10 + 1;
+
+  if (cost < competing_cost)
+    {
+      lut_sample (&babl->fish_lut, lut_source, lut_destination);
+
+      babl_fish_lut_process (babl, test_source, test_destination, num_test_pixels);
+      babl_fish_reference_process (fish_destination_to_rgba,
+                                   test_destination,
+                                   (char *) destination_rgba_double,
+                                   num_test_pixels);
+      babl->fish.error = babl_rel_avg_error (destination_rgba_double,
+                                             ref_destination_rgba_double,
+                                             num_test_pixels * 4);
+    }
+
+  babl_free (test_source);
+  babl_free (test_destination);
+  babl_free (destination_rgba_double);
+
+  if (babl->fish.error > (tolerance > 0.0 ? tolerance : babl_legal_error ()))
+    {
+      babl_free (babl);
+      return NULL;
+    }
+
+  /* another thread might have made one meanwhile */
+  babl_mutex_lock (babl_format_mutex);
+  existing = babl_db_exist_by_name (babl_fish_db (), name);
+  if (existing)
+    babl_free (babl);
+  else
+    babl_db_insert (babl_fish_db (), babl);
+  babl_mutex_unlock (babl_format_mutex);
+  return existing ? existing : babl;
+}
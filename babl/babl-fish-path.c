@@ -32,6 +32,8 @@
 
 #define NUM_TEST_PIXELS            (babl_get_num_path_test_pixels ())
 #define MAX_BUFFER_SIZE            1024  /* XXX: reasonable size for this should be profiled */
+#define MAX_WORKING_SET            (1 << 20)
+#define MAX_SMALL_SIZE             16    /* pixels converted with stack buffers */
 
 
 int   babl_in_fish_path = 0;
@@ -39,14 +41,17 @@ int   babl_in_fish_path = 0;
 typedef struct _FishPathInstrumentation
 {
   const Babl   *fmt_rgba_double;
+  const Babl   *fmt_source;
+  const Babl   *fmt_destination;
   int     num_test_pixels;
+  int     working_set;      /* pixels paths are timed on, the test pixels
+                               repeated */
+  int     untimed;          /* only measure the error, for static costs */
   void   *source;
   void   *destination;
-  void   *ref_destination;
+  const void   *ref_destination;              /* shared by all searches */
   double *destination_rgba_double;
-  double *ref_destination_rgba_double;
-  const Babl   *fish_rgba_to_source;
-  const Babl   *fish_reference;
+  const double *ref_destination_rgba_double;  /* shared by all searches */
   const Babl   *fish_destination_to_rgba;
   double  reference_cost;
   int     init_instrumentation_done;
@@ -56,12 +61,26 @@ typedef struct PathContext {
   Babl     *fish_path;
   Babl     *to_format;
   BablList *current_path;
+  int       candidates; /* paths reaching to_format that were measured */
+  double    tolerance;  /* the error paths are allowed */
+  int       improved;   /* times a better path was found */
+  BablList *fastest;    /* the fastest path within the tolerance, faster
+                           than the reference or not */
+  double    fastest_cost;
+  FishPathInstrumentation fpi; /* the buffers candidates are measured with */
+  double    static_cost; /* of the current path, with static costs */
+
+  /* searches with a budget go through paths by increasing length */
+  long long deadline;       /* nanoticks, 0 for none */
+  int       max_candidates; /* 0 for no limit */
+  int       length;         /* of the paths considered, 0 for all */
+  int       skip;           /* paths of length considered by a search before */
+  int       seen;           /* paths of length considered, or skipped */
+  int       stopped;        /* the budget ran out */
 } PathContext;
 
 static void
-init_path_instrumentation (FishPathInstrumentation *fpi,
-                           Babl                    *fmt_source,
-                           Babl                    *fmt_destination);
+init_path_instrumentation (FishPathInstrumentation *fpi);
 
 static void
 destroy_path_instrumentation (FishPathInstrumentation *fpi);
@@ -80,7 +99,21 @@ process_conversion_path (BablList   *path,
                          int         source_bpp,
                          void       *destination_buffer,
                          int         dest_bpp,
-                         long        n);
+                         long        n,
+                         long long  *nsecs);
+
+static long
+process_conversion_path_with_buffers (BablList   *path,
+                                      const void *source_buffer,
+                                      int         source_bpp,
+                                      void       *destination_buffer,
+                                      int         dest_bpp,
+                                      long        n,
+                                      long long  *nsecs,
+                                      void       *temp_buffer,
+                                      void       *temp_buffer2);
+
+static inline void *align_16 (unsigned char *ret);
 
 static void
 get_conversion_path (PathContext *pc,
@@ -92,14 +125,17 @@ static char *
 create_name (char       *buf,
              const Babl *source,
              const Babl *destination,
-             int         is_reference);
-
-static double legal_error (void);
+             int         is_reference,
+             double      tolerance);
 
 static int max_path_length (void);
 
+static int path_budget_exhausted (PathContext *pc);
 
-static double legal_error (void)
+static int timing_mask (void);
+
+
+double babl_legal_error (void)
 {
   static double error = 0.0;
   const char   *env;
@@ -115,6 +151,62 @@ static double legal_error (void)
   return error;
 }
 
+/* one in every BABL_TIMING_INTERVAL processings of a fish is timed, the
+ * interval is rounded up to a power of two, 0 disables the timing.
+ */
+static int timing_mask (void)
+{
+  static int  mask = -2;
+  const char *env;
+  int         interval;
+
+  if (mask != -2)
+    return mask;
+
+  env = getenv ("BABL_TIMING_INTERVAL");
+  if (env)
+    interval = atoi (env);
+  else
+    interval = 64;
+
+  if (interval <= 0)
+    {
+      mask = -1;
+    }
+  else
+    {
+      mask = 1;
+      while (mask < interval && mask < (1 << 30))
+        mask <<= 1;
+      mask--;
+    }
+  return mask;
+}
+
+/* the number of pixels candidate paths are timed on, large enough for the
+ * time to include moving the source, destination and intermediate buffers
+ * through the caches as when converting real images.
+ */
+int babl_path_working_set (void)
+{
+  static int  working_set = 0;
+  const char *env;
+
+  if (working_set != 0)
+    return working_set;
+
+  env = getenv ("BABL_PATH_WORKING_SET");
+  if (env)
+    working_set = atoi (env);
+  else
+    working_set = 16384;
+  if (working_set > MAX_WORKING_SET)
+    working_set = MAX_WORKING_SET;
+  else if (working_set < NUM_TEST_PIXELS)
+    working_set = NUM_TEST_PIXELS;
+  return working_set;
+}
+
 static int max_path_length (void)
 {
   static int  max_length = 0;
@@ -135,6 +227,34 @@ static int max_path_length (void)
   return max_length;
 }
 
+/* the budget of path searches not given one, BABL_PATH_BUDGET milliseconds
+ * of searching and BABL_PATH_CANDIDATES candidate paths measured */
+const BablPathBudget *
+babl_path_budget (void)
+{
+  static BablPathBudget budget = { -1, 0 };
+  const char           *env;
+  double                msecs;
+
+  if (budget.nsecs != -1)
+    return &budget;
+
+  env = getenv ("BABL_PATH_CANDIDATES");
+  if (env)
+    budget.candidates = atoi (env) > 0 ? atoi (env) : 0;
+  env = getenv ("BABL_PATH_BUDGET");
+  msecs = env ? atof (env) : 0.0;
+  budget.nsecs = msecs > 0.0 ? msecs * 1000000 : 0;
+  return &budget;
+}
+
+static int
+path_budget_exhausted (PathContext *pc)
+{
+  return (pc->max_candidates && pc->candidates >= pc->max_candidates) ||
+         (pc->deadline && babl_nanoticks () >= pc->deadline);
+}
+
 
 /* The task of BablFishPath construction is to compute
  * the shortest path in a graph where formats are the vertices
@@ -150,47 +270,78 @@ static int max_path_length (void)
  */
 
 
-static void
-get_conversion_path (PathContext *pc,
-                     Babl        *current_format,
-                     int          current_length,
-                     int          max_length)
+/* whether path is to be preferred over best at the same cost, the shorter
+ * path or the first one in the order of the names of their conversions */
+static int
+path_precedes (BablList *path,
+               BablList *best)
 {
-  if (current_length > max_length)
+  int i;
+
+  if (babl_list_size (path) != babl_list_size (best))
+    return babl_list_size (path) < babl_list_size (best);
+
+  for (i = 0; i < babl_list_size (path); i++)
     {
-      /* We have reached the maximum recursion
-       * depth, let's bail out */
-      return;
+      int order = strcmp (babl_conversion_stable_name (path->items[i]),
+                          babl_conversion_stable_name (best->items[i]));
+      if (order)
+        return order < 0;
     }
-  else if ((current_length > 0) && (current_format == pc->to_format))
-    {
-       /* We have found a candidate path, let's
-        * see about it's properties */
-      double path_cost  = 0.0;
-      double ref_cost   = 0.0;
-      double path_error = 1.0;
-      int    i;
+  return 0;
+}
 
-      for (i = 0; i < babl_list_size (pc->current_path); i++)
-        {
-          path_error *= (1.0 + babl_conversion_error ((BablConversion *) pc->current_path->items[i]));
-        }
+/* measures the current path of pc, making it the path of the fish when it
+ * is the best so far, returns whether it is within the tolerance */
+static int
+measure_path (PathContext *pc)
+{
+  double path_cost  = 0.0;
+  double ref_cost   = 0.0;
+  double path_error = 1.0;
+  int    within     = 0;
+  int    i;
 
-      if (path_error - 1.0 <= legal_error ()) /* check this before the next;
-                                                 which does a more accurate
-                                                 measurement of the error */
-        {
-          FishPathInstrumentation fpi;
-          memset (&fpi, 0, sizeof (fpi));
+  for (i = 0; i < babl_list_size (pc->current_path); i++)
+    {
+      path_error *= (1.0 + babl_conversion_error ((BablConversion *) pc->current_path->items[i]));
+    }
 
-          fpi.source = (Babl*) babl_list_get_first (pc->current_path)->conversion.source;
-          fpi.destination = pc->to_format;
+  if (path_error - 1.0 <= pc->tolerance) /* check this before the next;
+                                                  which does a more accurate
+                                                  measurement of the error */
+    {
+      pc->candidates++;
 
-          get_path_instrumentation (&fpi, pc->current_path, &path_cost, &ref_cost, &path_error);
+      get_path_instrumentation (&pc->fpi, pc->current_path, &path_cost, &ref_cost, &path_error);
+      within = path_error <= pc->tolerance;
 
+      if (pc->fpi.untimed)
+        {
+          /* the cost is the sum of the costs in the table, ties are
+           * broken independent of the order of registration */
+          path_cost = 0.0;
+          for (i = 0; i < babl_list_size (pc->current_path); i++)
+            path_cost += babl_path_costs_conversion (pc->current_path->items[i]);
+
+          if (path_error <= pc->tolerance &&
+              (path_cost < pc->fish_path->fish_path.cost ||
+               (path_cost == pc->fish_path->fish_path.cost &&
+                path_precedes (pc->current_path,
+                               pc->fish_path->fish_path.conversion_list))))
+            {
+              pc->fish_path->fish_path.cost = path_cost;
+              pc->fish_path->fish.error  = path_error;
+              babl_list_copy (pc->current_path,
+                              pc->fish_path->fish_path.conversion_list);
+              pc->improved++;
+            }
+        }
+      else
+        {
           if ((path_cost < ref_cost) && /* do not use paths that took longer to compute than reference */
               (path_cost < pc->fish_path->fish_path.cost) &&
-              (path_error <= legal_error ()))
+              (path_error <= pc->tolerance))
             {
               /* We have found the best path so far,
                * let's copy it into our new fish */
@@ -198,10 +349,97 @@ get_conversion_path (PathContext *pc,
               pc->fish_path->fish.error  = path_error;
               babl_list_copy (pc->current_path,
                               pc->fish_path->fish_path.conversion_list);
+              pc->improved++;
             }
+          /* what is slower than the reference here can still be the best
+           * way on for paths from other formats */
+          if (pc->fastest && path_cost < pc->fastest_cost &&
+              path_error <= pc->tolerance)
+            {
+              pc->fastest_cost = path_cost;
+              babl_list_copy (pc->current_path, pc->fastest);
+            }
+        }
+    }
+  return within;
+}
 
-          destroy_path_instrumentation (&fpi);
+/* measures the best known path on from current_format after the current
+ * path of pc first, the paths on from there considered after have to beat
+ * it. Returns 1 when they need not be considered: when none of the paths on
+ * from current_format was worth measuring, the errors of conversions only
+ * add up; or, with timed costs, when a search from current_format found the
+ * known path and the path it makes is within the tolerance. Paths found as
+ * a part of a path from another format, or chosen by static costs, only
+ * bound the search; static costs of other paths are not to depend on it.
+ */
+static int
+measure_memo_path (PathContext *pc,
+                   Babl        *current_format,
+                   int          current_length,
+                   int          max_length)
+{
+  int       searched = 0;
+  BablList *rest     = babl_path_memo_lookup (current_format, pc->to_format,
+                                              pc->fish_path->fish.tolerance,
+                                              &searched);
+  int       within;
+  int       i;
+
+  if (!rest)
+    return 0;
+  if (babl_list_size (rest) == 0)
+    return 1;
+
+  if (current_length + babl_list_size (rest) > max_length)
+    return 0;
+  for (i = 0; i < babl_list_size (rest) - 1; i++)
+    if (BABL (BABL (rest->items[i])->conversion.destination)->format.visited)
+      return 0;
+
+  for (i = 0; i < babl_list_size (rest); i++)
+    babl_list_insert_last (pc->current_path, rest->items[i]);
+  within = measure_path (pc);
+  for (i = 0; i < babl_list_size (rest); i++)
+    babl_list_remove_last (pc->current_path);
+  return within && searched && !pc->fpi.untimed;
+}
+
+static void
+get_conversion_path (PathContext *pc,
+                     Babl        *current_format,
+                     int          current_length,
+                     int          max_length)
+{
+  if (current_length > max_length || pc->stopped)
+    {
+      /* We have reached the maximum recursion
+       * depth, let's bail out */
+      return;
+    }
+  else if ((current_length > 0) && (current_format == pc->to_format))
+    {
+       /* We have found a candidate path, let's
+        * see about it's properties */
+      if (pc->length)
+        {
+          /* shorter paths were considered before */
+          if (current_length != pc->length)
+            return;
+          if (pc->seen < pc->skip)
+            {
+              pc->seen++;
+              return;
+            }
+          if (path_budget_exhausted (pc))
+            {
+              pc->stopped = 1;
+              return;
+            }
+          pc->seen++;
         }
+
+      measure_path (pc);
     }
   else
     {
@@ -211,6 +449,12 @@ get_conversion_path (PathContext *pc,
       BablList *list;
       int i;
 
+      /* the best known way on from here is measured first, budgeted
+       * searches resume by counting the paths they considered and are
+       * left alone */
+      if (!pc->length &&
+          measure_memo_path (pc, current_format, current_length, max_length))
+        return;
 
       list = current_format->format.from_list;
       if (list)
@@ -225,10 +469,25 @@ get_conversion_path (PathContext *pc,
               Babl *next_format = BABL (next_conversion->conversion.destination);
               if (!next_format->format.visited)
                 {
+                  double static_cost = pc->static_cost;
+
+                  /* with static costs, paths costing more than the best so
+                   * far already are not to become the best */
+                  if (pc->fpi.untimed && !pc->length)
+                    {
+                      pc->static_cost += babl_path_costs_conversion (next_conversion);
+                      if (pc->static_cost > pc->fish_path->fish_path.cost)
+                        {
+                          pc->static_cost = static_cost;
+                          continue;
+                        }
+                    }
+
                   /* next_format is not in the current path, we can pay a visit */
                   babl_list_insert_last (pc->current_path, next_conversion);
                   get_conversion_path (pc, next_format, current_length + 1, max_length);
                   babl_list_remove_last (pc->current_path);
+                  pc->static_cost = static_cost;
                 }
             }
 
@@ -242,11 +501,16 @@ static char *
 create_name (char       *buf,
              const Babl *source,
              const Babl *destination,
-             int         is_reference)
+             int         is_reference,
+             double      tolerance)
 {
   /* fish names are intentionally kept short */
-  snprintf (buf, BABL_MAX_NAME_LEN, "%s %p %p", "",
-            source, destination);
+  if (tolerance > 0.0)
+    snprintf (buf, BABL_MAX_NAME_LEN, "%s %p %p %g", "",
+              source, destination, tolerance);
+  else
+    snprintf (buf, BABL_MAX_NAME_LEN, "%s %p %p", "",
+              source, destination);
   return buf;
 }
 
@@ -254,131 +518,504 @@ static int
 babl_fish_path_destroy (void *data)
 {
   Babl *babl=data;
+  int   i;
+
   if (babl->fish_path.conversion_list)
     babl_free (babl->fish_path.conversion_list);
   babl->fish_path.conversion_list = NULL;
+  if (babl->fish_path.conversion_nsecs)
+    babl_free (babl->fish_path.conversion_nsecs);
+  babl->fish_path.conversion_nsecs = NULL;
+  for (i = 0; i < babl->fish_path.retired_count; i++)
+    babl_free (babl->fish_path.retired[i]);
+  if (babl->fish_path.retired)
+    babl_free (babl->fish_path.retired);
+  babl->fish_path.retired = NULL;
   return 0;
 }
 
+/* fishes whose searches ran out of budget before finding a path, kept out
+ * of the fish database until they find one, guarded by babl_format_mutex */
+static BablList *pending = NULL;
+
+static Babl *
+pending_find (const Babl *source,
+              const Babl *destination,
+              double      tolerance)
+{
+  int i;
+
+  for (i = 0; pending && i < babl_list_size (pending); i++)
+    {
+      Babl *babl = pending->items[i];
+
+      if (babl->fish.source == source &&
+          babl->fish.destination == destination &&
+          babl->fish.tolerance == tolerance)
+        return babl;
+    }
+  return NULL;
+}
+
+static void
+pending_remove (Babl *babl)
+{
+  int i;
+
+  for (i = 0; pending && i < babl_list_size (pending); i++)
+    if (pending->items[i] == babl)
+      {
+        pending->items[i] = pending->items[--pending->count];
+        return;
+      }
+}
+
+/* fishes in the fish database whose searches ran out of budget, continued
+ * by babl_fish_continue_searches () instead of by the lookups finding
+ * them, guarded by babl_format_mutex */
+static BablList *unfinished = NULL;
+
+void
+babl_fish_path_deinit (void)
+{
+  int i;
+
+  if (unfinished)
+    babl_free (unfinished);
+  unfinished = NULL;
+
+  if (!pending)
+    return;
+  for (i = 0; i < babl_list_size (pending); i++)
+    babl_free (pending->items[i]);
+  babl_free (pending);
+  pending = NULL;
+}
+
+/* searches for a better path for babl than the one it has. Without limits
+ * in budget all paths are considered at once, otherwise paths are
+ * considered by increasing length, from where the last search of babl ran
+ * out of budget; babl->fish_path.incomplete tells if this one did.
+ * Returns the number of times a better path was found.
+ */
+static int
+fish_path_search (Babl                 *babl,
+                  const BablPathBudget *budget)
+{
+  const Babl  *source      = babl->fish.source;
+  const Babl  *destination = babl->fish.destination;
+  int          max_length  = max_path_length ();
+  BablList    *memo;
+  PathContext  pc;
+
+  memset (&pc, 0, sizeof (pc));
+  pc.current_path = babl_list_init_with_size (BABL_HARD_MAX_PATH_LENGTH);
+  pc.fish_path    = babl;
+  pc.to_format    = (Babl *) destination;
+  pc.tolerance    = babl->fish.tolerance > 0.0 ? babl->fish.tolerance
+                                               : babl_legal_error ();
+  pc.fpi.fmt_source      = source;
+  pc.fpi.fmt_destination = destination;
+  pc.fpi.untimed         = babl_path_costs_static ();
+  /* the budget includes waiting for the lock and making the table below */
+  pc.deadline     = budget->nsecs ? babl_nanoticks () + budget->nsecs : 0;
+
+  babl_mutex_lock (babl_format_mutex);
+  /* we hold a global lock whilerunning get_conversion_path since
+   * it depends on keeping the various format.visited members in
+   * a consistent state, this code path is not performance critical
+   * since created fishes are cached. Extensions loaded on demand
+   * register under the same lock.
+   */
+  babl_in_fish_path++;
+  babl_extension_load_for_path (source, destination, max_length);
+  BABL_TRACE (PATH_SEARCH_BEGIN, path_search_begin, source, destination, 0);
+
+  /* a per component table, if the conversion permits it, is a candidate
+   * like any other registered conversion, made unless the time budget is
+   * spent already. With static costs the candidates are not to depend on
+   * the searches made before, which tables would make them do */
+  if (!babl_path_costs_static () &&
+      (!pc.deadline || babl_nanoticks () < pc.deadline))
+    babl_conversion_table (source, destination);
+
+  if (!budget->nsecs && !budget->candidates)
+    {
+      /* with the paths static costs choose, the path of the fish is the
+       * fastest within the tolerance */
+      if (!babl_path_costs_static ())
+        {
+          pc.fastest      = babl_list_init_with_size (BABL_HARD_MAX_PATH_LENGTH);
+          pc.fastest_cost = BABL_MAX_COST_VALUE;
+        }
+      get_conversion_path (&pc, (Babl *) source, 0, max_length);
+      babl->fish_path.incomplete = 0;
+
+      memo = pc.fastest ? pc.fastest : babl->fish_path.conversion_list;
+      /* the errors of conversions only add up, when none of the paths
+       * from here were worth measuring, neither are longer paths through
+       * here; measured errors are not passed on that way */
+      if (babl_list_size (memo) || !pc.candidates)
+        babl_path_memo_insert (source, destination, babl->fish.tolerance,
+                               memo);
+      if (pc.fastest)
+        babl_free (pc.fastest);
+    }
+  else
+    {
+      int length;
+
+      /* conversions registered since the last search might make shorter
+       * paths, which were considered without them */
+      if (babl->fish_path.search_conversions !=
+          babl_db_count (babl_conversion_db ()))
+        {
+          babl->fish_path.search_length      = 1;
+          babl->fish_path.search_skip        = 0;
+          babl->fish_path.search_conversions =
+            babl_db_count (babl_conversion_db ());
+        }
+
+      pc.max_candidates = budget->candidates;
+
+      for (length = babl->fish_path.search_length;
+           length <= max_length && !pc.stopped;
+           length++)
+        {
+          pc.length = length;
+          pc.skip   = length == babl->fish_path.search_length ?
+                        babl->fish_path.search_skip : 0;
+          pc.seen   = 0;
+          get_conversion_path (&pc, (Babl *) source, 0, length);
+
+          babl->fish_path.search_length = length;
+          babl->fish_path.search_skip   = pc.seen;
+        }
+      babl->fish_path.incomplete = pc.stopped;
+    }
+
+  BABL_TRACE (PATH_SEARCH_END, path_search_end,
+              source, destination, pc.candidates);
+  babl_in_fish_path--;
+  babl_mutex_unlock (babl_format_mutex);
+  destroy_path_instrumentation (&pc.fpi);
+  babl_free (pc.current_path);
+
+  return pc.improved;
+}
+
+/* continues the search of a fish other threads might be processing with,
+ * the list of conversions they use is kept until the fish is destroyed */
+static void
+fish_path_refine (Babl                 *babl,
+                  const BablPathBudget *budget)
+{
+  Babl *scratch = babl_calloc (1, sizeof (BablFishPath));
+
+  memcpy (scratch, babl, sizeof (BablFishPath));
+  scratch->fish_path.conversion_list =
+    babl_list_init_with_size (BABL_HARD_MAX_PATH_LENGTH);
+  babl_list_copy (babl->fish_path.conversion_list,
+                  scratch->fish_path.conversion_list);
+
+  if (fish_path_search (scratch, budget))
+    {
+      babl->fish_path.retired =
+        babl_realloc (babl->fish_path.retired,
+                      sizeof (BablList *) * (babl->fish_path.retired_count + 1));
+      babl->fish_path.retired[babl->fish_path.retired_count++] =
+        babl->fish_path.conversion_list;
+
+      babl->fish_path.cost            = scratch->fish_path.cost;
+      babl->fish.error                = scratch->fish.error;
+      babl->fish_path.conversion_list = scratch->fish_path.conversion_list;
+      memset (babl->fish_path.conversion_nsecs, 0,
+              sizeof (long long) * BABL_HARD_MAX_PATH_LENGTH);
+    }
+  else
+    {
+      babl_free (scratch->fish_path.conversion_list);
+    }
+
+  babl->fish_path.search_length      = scratch->fish_path.search_length;
+  babl->fish_path.search_skip        = scratch->fish_path.search_skip;
+  babl->fish_path.search_conversions = scratch->fish_path.search_conversions;
+  babl->fish_path.incomplete         = scratch->fish_path.incomplete;
+  babl_free (scratch);
+}
+
+/* finds the fastest path with an error of at most tolerance, or of
+ * babl_legal_error () when tolerance is 0.0 */
 Babl *
 babl_fish_path (const Babl *source,
-                const Babl *destination)
+                const Babl *destination,
+                double      tolerance)
+{
+  return babl_fish_path_with_budget (source, destination, tolerance,
+                                     NULL, NULL);
+}
+
+/* like babl_fish_path (), spending at most budget, or babl_path_budget ()
+ * when budget is NULL, on the search. A search running out of budget
+ * yields the best path found so far, continued by
+ * babl_fish_continue_searches (), or NULL with incomplete set when it
+ * found none yet; later calls for the same fish continue that search.
+ */
+Babl *
+babl_fish_path_with_budget (const Babl           *source,
+                            const Babl           *destination,
+                            double                tolerance,
+                            const BablPathBudget *budget,
+                            int                  *incomplete)
 {
   Babl *babl = NULL;
   char name[BABL_MAX_NAME_LEN];
 
-  create_name (name, source, destination, 1);
+  if (!budget)
+    budget = babl_path_budget ();
+  if (incomplete)
+    *incomplete = 0;
+
+  create_name (name, source, destination, 1, tolerance);
   babl = babl_db_exist_by_name (babl_fish_db (), name);
   if (babl)
     {
       /* There is an instance already registered by the required name,
-       * returning the preexistent one instead.
+       * returning the preexistent one instead, without waiting for the
+       * lock to continue its search if that is not done.
        */
       return babl;
     }
 
-  babl = babl_calloc (1, sizeof (BablFishPath) +
-                      strlen (name) + 1);
-  babl_set_destructor (babl, babl_fish_path_destroy);
-
-  babl->class_type                = BABL_FISH_PATH;
-  babl->instance.id               = babl_fish_get_id (source, destination);
-  babl->instance.name             = ((char *) babl) + sizeof (BablFishPath);
-  strcpy (babl->instance.name, name);
-  babl->fish.source               = source;
-  babl->fish.destination          = destination;
-  babl->fish.processings          = 0;
-  babl->fish.pixels               = 0;
-  babl->fish.error                = BABL_MAX_COST_VALUE;
-  babl->fish_path.cost            = BABL_MAX_COST_VALUE;
-  babl->fish_path.loss            = BABL_MAX_COST_VALUE;
-  babl->fish_path.conversion_list = babl_list_init_with_size (BABL_HARD_MAX_PATH_LENGTH);
-
-  {
-    PathContext pc;
-    pc.current_path = babl_list_init_with_size (BABL_HARD_MAX_PATH_LENGTH);
-    pc.fish_path = babl;
-    pc.to_format = (Babl *) destination;
-
-    if (babl_in_fish_path <= 0)
-      babl_mutex_lock (babl_format_mutex);
-    /* we hold a global lock whilerunning get_conversion_path since
-     * it depends on keeping the various format.visited members in
-     * a consistent state, this code path is not performance critical
-     * since created fishes are cached.
-     */
-    babl_in_fish_path++;
-
-    get_conversion_path (&pc, (Babl *) source, 0, max_path_length ());
-
-    babl_in_fish_path--;
-    if (babl_in_fish_path <= 0)
+  babl_mutex_lock (babl_format_mutex);
+  /* another thread, like one prewarming from a profile, might have made
+   * the fish while this one waited for the lock */
+  babl = babl_db_exist_by_name (babl_fish_db (), name);
+  if (babl)
+    {
       babl_mutex_unlock (babl_format_mutex);
-    babl_free (pc.current_path);
-  }
+      return babl;
+    }
+
+  babl = pending_find (source, destination, tolerance);
+  if (babl)
+    {
+      pending_remove (babl);
+    }
+  else
+    {
+      babl = babl_calloc (1, sizeof (BablFishPath) +
+                          strlen (name) + 1);
+      babl_set_destructor (babl, babl_fish_path_destroy);
+
+      babl->class_type                = BABL_FISH_PATH;
+      babl->instance.id               = babl_fish_get_id (source, destination);
+      babl->instance.name             = ((char *) babl) + sizeof (BablFishPath);
+      strcpy (babl->instance.name, name);
+      babl->fish.source               = source;
+      babl->fish.destination          = destination;
+      babl->fish.processings          = 0;
+      babl->fish.pixels               = 0;
+      babl->fish.error                = BABL_MAX_COST_VALUE;
+      babl->fish.tolerance            = tolerance;
+      babl->fish_path.cost            = BABL_MAX_COST_VALUE;
+      babl->fish_path.loss            = BABL_MAX_COST_VALUE;
+      babl->fish_path.conversion_list = babl_list_init_with_size (BABL_HARD_MAX_PATH_LENGTH);
+    }
+
+  fish_path_search (babl, budget);
 
   if (babl_list_size (babl->fish_path.conversion_list) == 0)
     {
-      babl_free (babl);
+      if (babl->fish_path.incomplete)
+        {
+          if (!pending)
+            pending = babl_list_init ();
+          babl_list_insert_last (pending, babl);
+          if (incomplete)
+            *incomplete = 1;
+        }
+      else
+        {
+          babl_free (babl);
+        }
+      babl_mutex_unlock (babl_format_mutex);
       return NULL;
     }
+  /* sized for the longest path, later searches might replace the path */
+  babl->fish_path.conversion_nsecs =
+    babl_calloc (BABL_HARD_MAX_PATH_LENGTH, sizeof (long long));
 
   /* Since there is not an already registered instance by the required
    * name, inserting newly created class into database.
    */
   babl_db_insert (babl_fish_db (), babl);
+  if (babl->fish_path.incomplete)
+    {
+      if (!unfinished)
+        unfinished = babl_list_init ();
+      babl_list_insert_last (unfinished, babl);
+    }
+  babl_mutex_unlock (babl_format_mutex);
   return babl;
 }
 
+int
+babl_fish_continue_searches (double msecs)
+{
+  long long deadline = msecs > 0.0 ?
+                       babl_nanoticks () + (long long) (msecs * 1000000) : 0;
+  int       left;
+  int       i = 0;
+
+  babl_mutex_lock (babl_format_mutex);
+  while (unfinished && i < babl_list_size (unfinished))
+    {
+      Babl           *babl   = unfinished->items[i];
+      BablPathBudget  budget = { 0, 0 };
+
+      if (deadline)
+        {
+          budget.nsecs = deadline - babl_nanoticks ();
+          if (budget.nsecs <= 0)
+            break;
+        }
+      fish_path_refine (babl, &budget);
+
+      if (babl->fish_path.incomplete)
+        i++;
+      else
+        unfinished->items[i] = unfinished->items[--unfinished->count];
+    }
+  left = unfinished ? babl_list_size (unfinished) : 0;
+  babl_mutex_unlock (babl_format_mutex);
+  return left;
+}
+
+/* single colors and tiny runs are converted through fixed buffers on the
+ * stack, calling the linear conversions directly, without the chunking and
+ * the buffer setup of process_conversion_path ()
+ */
+static long
+process_small_path (BablList   *path,
+                    const void *source,
+                    void       *destination,
+                    long        n)
+{
+  double      buffers[2][MAX_SMALL_SIZE * 5 + 2]; /* room for aligning */
+  void       *aux[2];
+  int         conversions = babl_list_size (path);
+  const void *src         = source;
+  int         i;
+
+  aux[0] = align_16 ((unsigned char *) buffers[0]);
+  aux[1] = align_16 ((unsigned char *) buffers[1]);
+
+  for (i = 0; i < conversions; i++)
+    {
+      Babl *conversion = path->items[i];
+      void *dst        = i == conversions - 1 ? destination : aux[i & 1];
+
+      if (conversion->class_type == BABL_CONVERSION_LINEAR)
+        {
+          conversion->conversion.function.linear (src, dst, n,
+                                                  conversion->conversion.data);
+          conversion->conversion.processings++;
+          conversion->conversion.pixels += n;
+        }
+      else
+        {
+          babl_conversion_process (conversion, src, dst, n);
+        }
+      src = dst;
+    }
+  return n;
+}
+
+static int
+path_bytes_per_pixel (const Babl *babl)
+{
+  switch (babl->instance.class_type)
+    {
+      case BABL_FORMAT:
+        return babl->format.bytes_per_pixel;
+      case BABL_TYPE:
+        return babl->type.bits / 8;
+      default:
+        babl_log ("eeek{%i}\n", babl->instance.class_type - BABL_MAGIC);
+    }
+  return 0;
+}
+
 static long
 babl_fish_path_process (Babl       *babl,
                         const void *source,
                         void       *destination,
-                        long        n)
-{
-   const Babl *babl_source = babl->fish.source;
-   const Babl *babl_dest = babl->fish.destination;
-   int source_bpp = 0;
-   int dest_bpp = 0;
-
-   switch (babl_source->instance.class_type)
-     {
-       case BABL_FORMAT:
-         source_bpp = babl_source->format.bytes_per_pixel;
-         break;
-       case BABL_TYPE:
-         source_bpp = babl_source->type.bits / 8;
-         break;
-       default:
-         babl_log ("=eeek{%i}\n", babl_source->instance.class_type - BABL_MAGIC);
-     }
-
-   switch (babl_dest->instance.class_type)
-     {
-       case BABL_FORMAT:
-         dest_bpp = babl_dest->format.bytes_per_pixel;
-         break;
-       case BABL_TYPE:
-         dest_bpp = babl_dest->type.bits / 8;
-         break;
-       default:
-         babl_log ("-eeek{%i}\n", babl_dest->instance.class_type - BABL_MAGIC);
-     }
+                        long        n,
+                        int         timed)
+{
+  if (n <= MAX_SMALL_SIZE && !timed)
+    return process_small_path (babl->fish_path.conversion_list,
+                               source, destination, n);
 
   return process_conversion_path (babl->fish_path.conversion_list,
                                   source,
-                                  source_bpp,
+                                  path_bytes_per_pixel (babl->fish.source),
                                   destination,
-                                  dest_bpp,
-                                  n);
+                                  path_bytes_per_pixel (babl->fish.destination),
+                                  n,
+                                  timed ? babl->fish_path.conversion_nsecs
+                                        : NULL);
+}
 
+/* processes count buffers through the path of a path fish, setting up the
+ * auxiliary buffers once for all of them, a timed batch times the
+ * conversions of the first buffer only, keeping the overhead of reading
+ * the clock per conversion off small buffers */
+static void
+babl_fish_path_process_many (Babl        *babl,
+                             const void **source,
+                             void       **destination,
+                             const long  *n,
+                             int          count,
+                             long         max_n,
+                             int          timed)
+{
+  BablList *path         = babl->fish_path.conversion_list;
+  int       conversions  = babl_list_size (path);
+  int       source_bpp   = path_bytes_per_pixel (babl->fish.source);
+  int       dest_bpp     = path_bytes_per_pixel (babl->fish.destination);
+  void     *temp_buffer  = NULL;
+  void     *temp_buffer2 = NULL;
+  long long *nsecs       = timed ? babl->fish_path.conversion_nsecs : NULL;
+  int       i;
+
+  if (conversions > 1)
+    temp_buffer = align_16 (alloca (MIN(max_n, MAX_BUFFER_SIZE) * sizeof (double) * 5 + 16));
+  if (conversions > 2)
+    temp_buffer2 = align_16 (alloca (MIN(max_n, MAX_BUFFER_SIZE) * sizeof (double) * 5 + 16));
+
+  for (i = 0; i < count; i++)
+    if (n[i] > 0)
+      {
+        process_conversion_path_with_buffers (path,
+                                              source[i], source_bpp,
+                                              destination[i], dest_bpp,
+                                              n[i], nsecs,
+                                              temp_buffer, temp_buffer2);
+        nsecs = NULL;
+      }
 }
 
-static long
+/* processes without counting in the stats of babl, which babl_process ()
+ * does for the callers; processings which are timed also time each
+ * conversion of a path */
+long
 babl_fish_process (Babl       *babl,
                    const void *source,
                    void       *destination,
-                   long        n)
+                   long        n,
+                   int         timed)
 {
   long ret = 0;
 
@@ -409,7 +1046,11 @@ babl_fish_process (Babl       *babl,
         break;
 
       case BABL_FISH_PATH:
-        ret = babl_fish_path_process (babl, source, destination, n);
+        ret = babl_fish_path_process (babl, source, destination, n, timed);
+        break;
+
+      case BABL_FISH_LUT:
+        ret = babl_fish_lut_process (babl, source, destination, n);
         break;
 
       default:
@@ -421,6 +1062,29 @@ babl_fish_process (Babl       *babl,
   return ret;
 }
 
+/* whether the next count processings of a fish include a timed one */
+static inline int
+timing_sampled (const Babl *babl,
+                int         count)
+{
+  int mask = timing_mask ();
+  int pos  = babl->fish.processings & mask;
+
+  return mask >= 0 && (pos == 0 || pos + count > mask + 1);
+}
+
+static inline void
+timing_add (Babl      *babl,
+            long long  nsecs,
+            long       pixels)
+{
+  babl->fish.sampled_nsecs += nsecs;
+  babl->fish.sampled_pixels += pixels;
+  babl->fish.pixels += pixels;
+  babl->fish.usecs = babl->fish.pixels *
+    ((double) babl->fish.sampled_nsecs / babl->fish.sampled_pixels) / 1000;
+}
+
 long
 babl_process (const Babl *cbabl,
               const void *source,
@@ -438,11 +1102,25 @@ babl_process (const Babl *cbabl,
 
   /* first check if it is a fish since that is our fast path */
   if (babl->class_type >= BABL_FISH &&
-      babl->class_type <= BABL_FISH_PATH)
+      babl->class_type <= BABL_FISH_LUT)
     {
+      BABL_TRACE (PROCESS_BEGIN, process_begin,
+                  babl->fish.source, babl->fish.destination, n);
+      if (timing_sampled (babl, 1))
+        {
+          long long start = babl_nanoticks ();
+          long pixels = babl_fish_process (babl, source, destination, n, 1);
+
+          timing_add (babl, babl_nanoticks () - start, pixels);
+        }
+      else
+        {
+          babl->fish.pixels +=
+                 babl_fish_process (babl, source, destination, n, 0);
+        }
       babl->fish.processings++;
-      babl->fish.pixels +=
-             babl_fish_process (babl, source, destination, n);
+      BABL_TRACE (PROCESS_END, process_end,
+                  babl->fish.source, babl->fish.destination, n);
       return n;
     }
 
@@ -455,49 +1133,135 @@ babl_process (const Babl *cbabl,
   return -1;
 }
 
+long
+babl_process_many (const Babl  *cbabl,
+                   const void **source,
+                   void       **destination,
+                   const long  *n,
+                   int          count)
+{
+  Babl *babl  = (Babl*)cbabl;
+  long  total = 0;
+  long  max_n = 0;
+  int   i;
+
+  babl_assert (babl);
+  babl_assert (BABL_IS_BABL (babl));
+  babl_assert (count >= 0);
+  if (count == 0)
+    return 0;
+  babl_assert (source);
+  babl_assert (destination);
+  babl_assert (n);
+
+  for (i = 0; i < count; i++)
+    {
+      babl_assert (n[i] >= 0);
+      babl_assert (n[i] == 0 || (source[i] && destination[i]));
+      total += n[i];
+      if (n[i] > max_n)
+        max_n = n[i];
+    }
+
+  if (babl->class_type >= BABL_FISH &&
+      babl->class_type <= BABL_FISH_LUT)
+    {
+      int       timed = timing_sampled (babl, count);
+      long long start = 0;
+
+      BABL_TRACE (PROCESS_BEGIN, process_begin,
+                  babl->fish.source, babl->fish.destination, total);
+      if (timed)
+        start = babl_nanoticks ();
+
+      if (babl->class_type == BABL_FISH_PATH)
+        {
+          babl_fish_path_process_many (babl, source, destination, n, count,
+                                       max_n, timed);
+        }
+      else
+        {
+          for (i = 0; i < count; i++)
+            if (n[i] > 0)
+              babl_fish_process (babl, source[i], destination[i], n[i], 0);
+        }
+
+      if (timed)
+        timing_add (babl, babl_nanoticks () - start, total);
+      else
+        babl->fish.pixels += total;
+      babl->fish.processings += count;
+      BABL_TRACE (PROCESS_END, process_end,
+                  babl->fish.source, babl->fish.destination, total);
+      return total;
+    }
+
+  for (i = 0; i < count; i++)
+    if (n[i] > 0)
+      babl_process (babl, source[i], destination[i], n[i]);
+  return total;
+}
+
 #include <stdint.h>
 
 #define BABL_ALIGN 16
-static void inline *align_16 (unsigned char *ret)
+static inline void *align_16 (unsigned char *ret)
 {
   int offset = BABL_ALIGN - ((uintptr_t) ret) % BABL_ALIGN;
   ret = ret + offset;
   return ret;
 }
 
+/* runs one conversion of a path, adding the time it took to *nsecs
+ * unless nsecs is NULL */
+static inline void
+process_conversion (Babl       *conversion,
+                    const void *source,
+                    void       *destination,
+                    long        n,
+                    long long  *nsecs)
+{
+  if (nsecs)
+    {
+      long long start = babl_nanoticks ();
+      babl_conversion_process (conversion, source, destination, n);
+      *nsecs += babl_nanoticks () - start;
+    }
+  else
+    {
+      babl_conversion_process (conversion, source, destination, n);
+    }
+}
+
+/* processes n pixels through path using the auxiliary buffers, which
+ * hold MIN (n, MAX_BUFFER_SIZE) pixels, temp_buffer2 is only needed for
+ * paths of more than two conversions
+ */
 static long
-process_conversion_path (BablList   *path,
-                         const void *source_buffer,
-                         int         source_bpp,
-                         void       *destination_buffer,
-                         int         dest_bpp,
-                         long        n)
+process_conversion_path_with_buffers (BablList   *path,
+                                      const void *source_buffer,
+                                      int         source_bpp,
+                                      void       *destination_buffer,
+                                      int         dest_bpp,
+                                      long        n,
+                                      long long  *nsecs,
+                                      void       *temp_buffer,
+                                      void       *temp_buffer2)
 {
   int conversions = babl_list_size (path);
 
   if (conversions == 1)
     {
-      babl_conversion_process (BABL (babl_list_get_first (path)),
-                               source_buffer,
-                               destination_buffer,
-                               n);
+      process_conversion (BABL (babl_list_get_first (path)),
+                          source_buffer,
+                          destination_buffer,
+                          n,
+                          nsecs);
     }
   else
     {
       long j;
 
-      void *temp_buffer = align_16 (alloca (MIN(n, MAX_BUFFER_SIZE) * sizeof (double) * 5 + 16));
-      void *temp_buffer2 = NULL;
-
-      if (conversions > 2)
-        {
-          /* We'll need one more auxiliary buffer */
-          temp_buffer2 = align_16 (alloca (MIN(n, MAX_BUFFER_SIZE) * sizeof (double) * 5 + 16));
-        }
-
-
-
-
       for (j = 0; j < n; j+= MAX_BUFFER_SIZE)
         {
           long c = MIN (n - j, MAX_BUFFER_SIZE);
@@ -510,19 +1274,21 @@ process_conversion_path (BablList   *path,
           aux2_buffer = temp_buffer2;
 
           /* The first conversion goes from source_buffer to aux1_buffer */
-          babl_conversion_process (babl_list_get_first (path),
-                                   (void*)(((unsigned char*)source_buffer) + (j * source_bpp)),
-                                   aux1_buffer,
-                                   c);
+          process_conversion (babl_list_get_first (path),
+                              (void*)(((unsigned char*)source_buffer) + (j * source_bpp)),
+                              aux1_buffer,
+                              c,
+                              nsecs);
 
           /* Process, if any, conversions between the first and the last
            * conversion in the path, in a loop */
           for (i = 1; i < conversions - 1; i++)
             {
-              babl_conversion_process (path->items[i],
-                                       aux1_buffer,
-                                       aux2_buffer,
-                                       c);
+              process_conversion (path->items[i],
+                                  aux1_buffer,
+                                  aux2_buffer,
+                                  c,
+                                  nsecs ? nsecs + i : NULL);
               /* Swap the auxiliary buffers */
               swap_buffer = aux1_buffer;
               aux1_buffer = aux2_buffer;
@@ -530,25 +1296,54 @@ process_conversion_path (BablList   *path,
             }
 
           /* The last conversion goes from aux1_buffer to destination_buffer */
-          babl_conversion_process (babl_list_get_last (path),
-                                   aux1_buffer,
-                                   (void*)((unsigned char*)destination_buffer + (j * dest_bpp)),
-                                   c);
+          process_conversion (babl_list_get_last (path),
+                              aux1_buffer,
+                              (void*)((unsigned char*)destination_buffer + (j * dest_bpp)),
+                              c,
+                              nsecs ? nsecs + conversions - 1 : NULL);
         }
   }
 
   return n;
 }
 
-static void
-init_path_instrumentation (FishPathInstrumentation *fpi,
-                           Babl                    *fmt_source,
-                           Babl                    *fmt_destination)
+static long
+process_conversion_path (BablList   *path,
+                         const void *source_buffer,
+                         int         source_bpp,
+                         void       *destination_buffer,
+                         int         dest_bpp,
+                         long        n,
+                         long long  *nsecs)
 {
-  long   ticks_start = 0;
-  long   ticks_end   = 0;
+  int   conversions  = babl_list_size (path);
+  void *temp_buffer  = NULL;
+  void *temp_buffer2 = NULL;
+
+  if (conversions > 1)
+    temp_buffer = align_16 (alloca (MIN(n, MAX_BUFFER_SIZE) * sizeof (double) * 5 + 16));
+  if (conversions > 2)
+    {
+      /* We'll need one more auxiliary buffer */
+      temp_buffer2 = align_16 (alloca (MIN(n, MAX_BUFFER_SIZE) * sizeof (double) * 5 + 16));
+    }
+
+  return process_conversion_path_with_buffers (path,
+                                               source_buffer, source_bpp,
+                                               destination_buffer, dest_bpp,
+                                               n, nsecs,
+                                               temp_buffer, temp_buffer2);
+}
 
-  const double *test_pixels = babl_get_path_test_pixels ();
+static void
+init_path_instrumentation (FishPathInstrumentation *fpi)
+{
+  const Babl *fmt_source      = fpi->fmt_source;
+  const Babl *fmt_destination = fpi->fmt_destination;
+  int         source_bpp      = fmt_source->format.bytes_per_pixel;
+  long long   reference_nsecs = 0;
+  const void *test_buffer;
+  int         i;
 
   if (!fpi->fmt_rgba_double)
     {
@@ -563,39 +1358,34 @@ init_path_instrumentation (FishPathInstrumentation *fpi,
     }
 
   fpi->num_test_pixels = babl_get_num_path_test_pixels ();
+  fpi->working_set     = fpi->untimed ? fpi->num_test_pixels
+                                      : babl_path_working_set ();
 
-  fpi->fish_rgba_to_source      = babl_fish_reference (fpi->fmt_rgba_double,
-                                                  fmt_source);
-  fpi->fish_reference           = babl_fish_reference (fmt_source,
-                                                  fmt_destination);
   fpi->fish_destination_to_rgba = babl_fish_reference (fmt_destination,
                                                   fpi->fmt_rgba_double);
 
-  fpi->source                      = babl_calloc (fpi->num_test_pixels,
-                                             fmt_source->format.bytes_per_pixel);
-  fpi->destination                 = babl_calloc (fpi->num_test_pixels,
-                                             fmt_destination->format.bytes_per_pixel);
-  fpi->ref_destination             = babl_calloc (fpi->num_test_pixels,
+  fpi->source                      = babl_malloc (fpi->working_set *
+                                             source_bpp);
+  fpi->destination                 = babl_malloc (fpi->working_set *
                                              fmt_destination->format.bytes_per_pixel);
   fpi->destination_rgba_double     = babl_calloc (fpi->num_test_pixels,
                                              fpi->fmt_rgba_double->format.bytes_per_pixel);
-  fpi->ref_destination_rgba_double = babl_calloc (fpi->num_test_pixels,
-                                             fpi->fmt_rgba_double->format.bytes_per_pixel);
 
-  /* create sourcebuffer from testbuffer in the correct format */
-  babl_process (fpi->fish_rgba_to_source,
-                test_pixels, fpi->source, fpi->num_test_pixels);
-
-  /* calculate the reference buffer of how it should be */
-  ticks_start = babl_ticks ();
-  babl_process (fpi->fish_reference,
-                fpi->source, fpi->ref_destination, fpi->num_test_pixels);
-  ticks_end = babl_ticks ();
-  fpi->reference_cost = babl_process_cost (ticks_start, ticks_end);
-
-  /* transform the reference destination buffer to RGBA */
-  babl_process (fpi->fish_destination_to_rgba,
-                fpi->ref_destination, fpi->ref_destination_rgba_double, fpi->num_test_pixels);
+  /* the source buffer is the test pixels in the source format, repeated
+   * to fill the working set */
+  test_buffer = babl_path_test_buffer (fmt_source);
+  for (i = 0; i < fpi->working_set; i += fpi->num_test_pixels)
+    memcpy ((char *) fpi->source + (long) i * source_bpp, test_buffer,
+            (long) MIN (fpi->num_test_pixels, fpi->working_set - i) * source_bpp);
+  /* have the pages of the destination mapped before timing into it */
+  memset (fpi->destination, 0,
+          (long) fpi->working_set * fmt_destination->format.bytes_per_pixel);
+
+  /* the reference buffer of how it should be, directly and as RGBA */
+  fpi->ref_destination = babl_path_reference (fmt_source, fmt_destination,
+                                              &fpi->ref_destination_rgba_double,
+                                              &reference_nsecs);
+  fpi->reference_cost = reference_nsecs / 1000.0 * 10 + 1;
 }
 
 static void
@@ -606,8 +1396,6 @@ destroy_path_instrumentation (FishPathInstrumentation *fpi)
       babl_free (fpi->source);
       babl_free (fpi->destination);
       babl_free (fpi->destination_rgba_double);
-      babl_free (fpi->ref_destination);
-      babl_free (fpi->ref_destination_rgba_double);
 
       /* nulify the flag for potential new search */
       fpi->init_instrumentation_done = 0;
@@ -621,11 +1409,11 @@ get_path_instrumentation (FishPathInstrumentation *fpi,
                           double                  *ref_cost,
                           double                  *path_error)
 {
-  long   ticks_start = 0;
-  long   ticks_end   = 0;
+  long long ticks_start = 0;
+  long long ticks_end   = 0;
 
-  Babl *babl_source = fpi->source;
-  Babl *babl_destination = fpi->destination;
+  const Babl *babl_source = fpi->fmt_source;
+  const Babl *babl_destination = fpi->fmt_destination;
 
   int source_bpp = 0;
   int dest_bpp = 0;
@@ -659,35 +1447,45 @@ get_path_instrumentation (FishPathInstrumentation *fpi,
       /* this initialization can be done only once since the
        * source and destination formats do not change during
        * the search */
-      init_path_instrumentation (fpi, babl_source, babl_destination);
+      init_path_instrumentation (fpi);
       fpi->init_instrumentation_done = 1;
     }
+  else
+    {
+      /* what the last candidate made is not taken for what this one did
+       * not write */
+      memset (fpi->destination, 0, (long) fpi->num_test_pixels * dest_bpp);
+    }
 
-  /* calculate this path's view of what the result should be */
-  ticks_start = babl_ticks ();
-  process_conversion_path (path, fpi->source, source_bpp, fpi->destination, dest_bpp, fpi->num_test_pixels);
-  ticks_end = babl_ticks ();
-  *path_cost = babl_process_cost (ticks_start, ticks_end);
-
-  /* transform the reference and the actual destination buffers to RGBA
-   * for comparison with each other
+  /* calculate this path's view of what the result should be, timed on
+   * the whole working set but costed in the ticks of the test pixels, like
+   * the reference fish */
+  ticks_start = babl_nanoticks ();
+  process_conversion_path (path, fpi->source, source_bpp, fpi->destination, dest_bpp, fpi->working_set, NULL);
+  ticks_end = babl_nanoticks ();
+  *path_cost = (ticks_end - ticks_start) / 1000.0 *
+               fpi->num_test_pixels / fpi->working_set * 10 + 1;
+
+  /* a path making what the reference makes has no error, otherwise the
+   * destination buffer is transformed to RGBA for comparison with the
+   * reference
    */
-  babl_process (fpi->fish_destination_to_rgba,
-                fpi->destination, fpi->destination_rgba_double, fpi->num_test_pixels);
-
-  *path_error = babl_rel_avg_error (fpi->destination_rgba_double,
-                                    fpi->ref_destination_rgba_double,
-                                    fpi->num_test_pixels * 4);
-
-#if 0
-  fpi->fish_rgba_to_source->fish.processings--;
-  fpi->fish_reference->fish.processings--;
-  fpi->fish_destination_to_rgba->fish.processings -= 2;
-
-  fpi->fish_rgba_to_source->fish.pixels      -= fpi->num_test_pixels;
-  fpi->fish_reference->fish.pixels           -= fpi->num_test_pixels;
-  fpi->fish_destination_to_rgba->fish.pixels -= 2 * fpi->num_test_pixels;
-#endif
+  if (!memcmp (fpi->destination, fpi->ref_destination,
+               (long) fpi->num_test_pixels * dest_bpp))
+    {
+      *path_error = 0.0;
+    }
+  else
+    {
+      babl_fish_reference_process (fpi->fish_destination_to_rgba,
+                                   fpi->destination,
+                                   (char *) fpi->destination_rgba_double,
+                                   fpi->num_test_pixels);
+
+      *path_error = babl_rel_avg_error (fpi->destination_rgba_double,
+                                        fpi->ref_destination_rgba_double,
+                                        fpi->num_test_pixels * 4);
+    }
 
   *ref_cost = fpi->reference_cost;
 }
@@ -0,0 +1,247 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* When BABL_FISH_PROFILE names a file, babl_exit () adds the fishes the
+ * process asked for to it, and babl_prewarm_from_profile () creates the
+ * fishes listed in such a file before they are asked for. Fishes are kept
+ * by the names of their formats, the same for all versions of babl,
+ *
+ *   babl-fish-profile 1
+ *   <source format>\t<destination format>\t<tolerance>
+ *
+ * with a tolerance of 0 for fishes of the default tolerance. Fishes of
+ * palette formats are left out.
+ */
+
+#include "config.h"
+#include <string.h>
+#include "babl-internal.h"
+
+#define BABL_FISH_PROFILE_HEADER  "babl-fish-profile 1"
+
+typedef struct FishProfile
+{
+  char **lines;  /* "source\tdestination\ttolerance" */
+  int    count;
+  int    size;
+} FishProfile;
+
+static void
+profile_add (FishProfile *profile,
+             const char  *line)
+{
+  if (profile->count == profile->size)
+    {
+      profile->size  = profile->size ? profile->size * 2 : 64;
+      profile->lines = babl_realloc (profile->lines,
+                                     sizeof (char *) * profile->size);
+    }
+  profile->lines[profile->count++] = babl_strdup (line);
+}
+
+static int
+line_compare (const void *a,
+              const void *b)
+{
+  return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+static int
+profile_find (FishProfile *profile,
+              int          sorted,
+              const char  *line)
+{
+  return sorted && bsearch (&line, profile->lines, sorted, sizeof (char *),
+                            line_compare);
+}
+
+static void
+profile_destroy (FishProfile *profile)
+{
+  int i;
+
+  for (i = 0; i < profile->count; i++)
+    babl_free (profile->lines[i]);
+  if (profile->lines)
+    babl_free (profile->lines);
+}
+
+/* reads the lines of a profile, returns 0 if it could not be read */
+static int
+profile_read (FishProfile *profile,
+              const char  *path)
+{
+  FILE *file = fopen (path, "r");
+  char  line[1024];
+
+  if (!file)
+    return 0;
+
+  if (!fgets (line, sizeof (line), file))
+    line[0] = '\0';
+  line[strcspn (line, "\r\n")] = '\0';
+  if (strcmp (line, BABL_FISH_PROFILE_HEADER))
+    {
+      fclose (file);
+      return 0;
+    }
+
+  while (fgets (line, sizeof (line), file))
+    {
+      line[strcspn (line, "\r\n")] = '\0';
+      if (strchr (line, '\t'))
+        profile_add (profile, line);
+    }
+  fclose (file);
+  return 1;
+}
+
+/* a format by name, loading the extension registering it if needed */
+static const Babl *
+format_by_name (const char *name)
+{
+  Babl *babl = babl_db_exist_by_name (babl_format_db (), name);
+
+  if (!babl && babl_extension_load_providing ("format", name))
+    babl = babl_db_exist_by_name (babl_format_db (), name);
+  return babl;
+}
+
+int
+babl_prewarm_from_profile (const char *path)
+{
+  FishProfile profile = { NULL, 0, 0 };
+  int         fishes  = 0;
+  int         i;
+
+  profile_read (&profile, path);
+
+  for (i = 0; i < profile.count; i++)
+    {
+      char       *source_name = profile.lines[i];
+      char       *destination_name;
+      char       *tolerance;
+      const Babl *source;
+      const Babl *destination;
+
+      destination_name = strchr (source_name, '\t');
+      *destination_name++ = '\0';
+      tolerance = strchr (destination_name, '\t');
+      if (tolerance)
+        *tolerance++ = '\0';
+
+      /* formats of extensions no longer installed, or named after
+       * addresses like palettes, are skipped */
+      source      = format_by_name (source_name);
+      destination = format_by_name (destination_name);
+      if (!source || !destination)
+        continue;
+
+      if (babl_fish_with_tolerance (source, destination,
+                                    tolerance ? strtod (tolerance, NULL) : 0.0))
+        fishes++;
+    }
+
+  /* searches which ran out of budget are finished here, off the threads
+   * asking for the fishes */
+  babl_fish_continue_searches (0.0);
+
+  profile_destroy (&profile);
+  return fishes;
+}
+
+static int
+collect_fish (Babl *babl,
+              void *data)
+{
+  char line[1024];
+
+  /* path fishes and the markers of pairs without a path are made for
+   * babl_fish (), references and simple fishes for measurements */
+  if (babl->class_type != BABL_FISH_PATH &&
+      babl->class_type != BABL_FISH)
+    return 0;
+  if (babl->fish.source->class_type != BABL_FORMAT ||
+      babl->fish.destination->class_type != BABL_FORMAT)
+    return 0;
+  /* palettes are named per process, or by the application for colors
+   * another process need not have */
+  if (babl_format_is_palette (babl->fish.source) ||
+      babl_format_is_palette (babl->fish.destination))
+    return 0;
+
+  snprintf (line, sizeof (line), "%s\t%s\t%g",
+            babl->fish.source->instance.name,
+            babl->fish.destination->instance.name,
+            babl->fish.tolerance);
+  profile_add (data, line);
+  return 0;
+}
+
+/* adds the fishes of this process missing in the BABL_FISH_PROFILE file */
+void
+babl_fish_profile_save (void)
+{
+  const char  *path     = getenv ("BABL_FISH_PROFILE");
+  FishProfile  profile  = { NULL, 0, 0 };
+  FishProfile  created  = { NULL, 0, 0 };
+  int          recorded;
+  int          added    = 0;
+  int          i;
+  FILE        *file;
+  char        *temp_path;
+
+  if (!path || !path[0])
+    return;
+
+  profile_read (&profile, path);
+  recorded = profile.count;
+  if (recorded)
+    qsort (profile.lines, recorded, sizeof (char *), line_compare);
+
+  babl_db_each (babl_fish_db (), collect_fish, &created);
+  for (i = 0; i < created.count; i++)
+    if (!profile_find (&profile, recorded, created.lines[i]))
+      {
+        profile_add (&profile, created.lines[i]);
+        added++;
+      }
+
+  if (added)
+    {
+      qsort (profile.lines, profile.count, sizeof (char *), line_compare);
+      /* services exiting at once each put a whole profile in place */
+      file = babl_file_replace_open (path, &temp_path);
+      if (!file)
+        {
+          babl_log ("unable to write fish profile to %s", path);
+        }
+      else
+        {
+          fprintf (file, "%s\n", BABL_FISH_PROFILE_HEADER);
+          for (i = 0; i < profile.count; i++)
+            if (i == 0 || strcmp (profile.lines[i], profile.lines[i - 1]))
+              fprintf (file, "%s\n", profile.lines[i]);
+          if (!babl_file_replace_close (file, path, temp_path))
+            babl_log ("unable to write fish profile to %s", path);
+        }
+    }
+
+  profile_destroy (&created);
+  profile_destroy (&profile);
+}
@@ -31,12 +31,11 @@ assert_conversion_find (const void *source,
 }
 
 static char *
-create_name (const Babl *source,
+create_name (char       *buf,
+             const Babl *source,
              const Babl *destination,
              int   is_reference)
 {
-  static char buf[1024];
-
   /* fish names are intentionally kept short */
   snprintf (buf, 1024, "%s %p %p",
             is_reference ? "ref "
@@ -51,14 +50,19 @@ babl_fish_reference (const Babl *source,
                      const Babl *destination)
 {
   Babl *babl = NULL;
-  char *name = create_name (source, destination, 1);
+  char  buf[1024];
+  char *name = create_name (buf, source, destination, 1);
 
+  /* held until the new fish is in the database, for threads measuring
+   * conversions at the same time to share it */
+  babl_mutex_lock (babl_reference_mutex);
   babl = babl_db_exist_by_name (babl_fish_db (), name);
   if (babl)
     {
       /* There is an instance already registered by the required name,
        * returning the preexistent one instead.
        */
+      babl_mutex_unlock (babl_reference_mutex);
       return babl;
     }
 
@@ -79,6 +83,10 @@ babl_fish_reference (const Babl *source,
 
   babl->fish.processings = 0;
   babl->fish.pixels      = 0;
+  babl->fish.usecs       = 0;
+  babl->fish.tolerance   = 0.0;
+  babl->fish.sampled_pixels = 0;
+  babl->fish.sampled_nsecs  = 0;
   babl->fish.error       = 0.0;  /* assuming the provided reference conversions for types
                                     and models are as exact as possible
                                   */
@@ -87,6 +95,7 @@ babl_fish_reference (const Babl *source,
    * name, inserting newly created class into database.
    */
   babl_db_insert (babl_fish_db (), babl);
+  babl_mutex_unlock (babl_reference_mutex);
   return babl;
 }
 
@@ -34,12 +34,14 @@ babl_fish_simple (BablConversion *conversion)
   babl_assert (BABL_IS_BABL (conversion));
 
   name = create_name (conversion);
+  babl_mutex_lock (babl_reference_mutex);
   babl = babl_db_exist_by_name (babl_fish_db (), name);
   if (babl)
     {
       /* There is an instance already registered by the required name,
        * returning the preexistent one instead.
        */
+      babl_mutex_unlock (babl_reference_mutex);
       return babl;
     }
 
@@ -54,6 +56,10 @@ babl_fish_simple (BablConversion *conversion)
 
   babl->fish.processings       = 0;
   babl->fish.pixels            = 0;
+  babl->fish.usecs             = 0;
+  babl->fish.tolerance         = 0.0;
+  babl->fish.sampled_pixels    = 0;
+  babl->fish.sampled_nsecs     = 0;
   babl->fish_simple.conversion = conversion;
   babl->fish.error             = 0.0;/* babl fish simple should only be used by bablfish
                                    reference, and babl fish reference only requests clean
@@ -63,5 +69,6 @@ babl_fish_simple (BablConversion *conversion)
    * name, inserting newly created class into database.
    */
   babl_db_insert (babl_fish_db (), babl);
+  babl_mutex_unlock (babl_reference_mutex);
   return babl;
 }
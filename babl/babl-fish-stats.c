@@ -40,9 +40,9 @@ table_destination_sum_each (Babl *babl,
 
   if (source != destination)
     {
-      const Babl *fish = babl_fish (source, destination);
-      babl_assert (fish);
-      sum_pixels += fish->fish.pixels;
+      const Babl *fish = babl_fish_lookup (source, destination);
+      if (fish)
+        sum_pixels += fish->fish.pixels;
     }
   return 0;
 }
@@ -72,13 +72,15 @@ table_destination_each (Babl *babl,
   Babl *destination = babl;
 
   qux++;
-  if (qux % babl_formats_count () == qux / babl_formats_count ())
+  if (qux % babl_formats_count () == qux / babl_formats_count () ||
+      !babl_fish_lookup (source, destination))
     fprintf (output_file, "<td class='cell'>&nbsp;</td>");
   else
     {
-      const Babl *fish = babl_fish (source, destination);
-
-      babl_assert (fish);
+      /* only fishes that have been created are shown, creating the others
+       * would search paths for pairs that were never used.
+       */
+      const Babl *fish = babl_fish_lookup (source, destination);
 
 
       switch (fish->class_type)
@@ -163,6 +165,23 @@ table_destination_each (Babl *babl,
             fprintf (output_file, "</a></td>\n");
             break;
 
+          case BABL_FISH_LUT:
+            fprintf (output_file, "<td class='cell'%s><a href='javascript:o()'>&loz;",
+                     fish->fish.pixels / sum_pixels > LIMIT ? " style='background-color: #69f'" : "");
+            fprintf (output_file, "<div class='tooltip'>");
+            fprintf (output_file, "<h3><span class='g'>Lut</span> %s <span class='g'>to</span> %s</h3>", source->instance.name, destination->instance.name);
+            fprintf (output_file, "<span class='g'>grid:</span> %i&sup3;<br/>", fish->fish_lut.grid);
+            fprintf (output_file, "<span class='g'>error:</span> %e<br/>", fish->fish.error);
+
+            if (fish->fish.processings > 0)
+              {
+                fprintf (output_file, "<span class='g'>Processings:</span>%i<br/>", fish->fish.processings);
+                fprintf (output_file, "<span class='g'>Pixels:</span>%li<br/>", fish->fish.pixels);
+              }
+            fprintf (output_file, "</div>");
+            fprintf (output_file, "</a></td>\n");
+            break;
+
           default:
             babl_fatal ("Unknown fish type");
             break;
@@ -240,24 +259,6 @@ table_source_each (Babl *babl,
   return 0;
 }
 
-/* copied from babl-fish-path.c */
-#define BABL_LEGAL_ERROR    0.000001
-static double legal_error (void)
-{
-  static double error = 0.0;
-  const char   *env;
-
-  if (error != 0.0)
-    return error;
-
-  env = getenv ("BABL_TOLERANCE");
-  if (env && env[0] != '\0')
-    error = atof (env);
-  else
-    error = BABL_LEGAL_ERROR;
-  return error;
-}
-
 static int
 each_conv (Babl *babl,
            void *data)
@@ -270,7 +271,7 @@ each_conv (Babl *babl,
   error = babl_conversion_error (&babl->conversion);
   cost  = babl_conversion_cost (&babl->conversion);
 
-  if (error > legal_error ())
+  if (error > babl_legal_error ())
     {
       fprintf (output_file, "<dt style='background-color: #fcc;'>%s</dt>", babl->instance.name);
       fprintf (output_file, "<dd style='background-color: #fcc;'>");
@@ -430,3 +431,203 @@ babl_fish_stats (FILE *file)
   fprintf (output_file, "</body></html>\n");
 }
 
+
+int
+babl_fish_get_stats (const Babl    *fish,
+                     BablFishStats *stats)
+{
+  memset (stats, 0, sizeof (BablFishStats));
+  if (!fish || !BABL_IS_BABL (fish) ||
+      fish->class_type < BABL_FISH || fish->class_type > BABL_FISH_LUT)
+    return 0;
+
+  stats->fish        = fish;
+  stats->source      = babl_get_name (fish->fish.source);
+  stats->destination = babl_get_name (fish->fish.destination);
+  stats->kind        = babl_class_name (fish->class_type);
+  stats->processings = fish->fish.processings;
+  stats->pixels      = fish->fish.pixels;
+  stats->usecs       = fish->fish.usecs;
+  stats->error       = fish->fish.error;
+  stats->tolerance   = fish->fish.tolerance;
+  if (fish->fish.sampled_pixels > 0)
+    stats->ns_per_pixel = (double) fish->fish.sampled_nsecs /
+                          fish->fish.sampled_pixels;
+  stats->memory      = sizeof (BablFish) + strlen (fish->instance.name) + 1;
+
+  switch (fish->class_type)
+    {
+      case BABL_FISH_PATH:
+        {
+          BablList *list = fish->fish_path.conversion_list;
+          int       i;
+
+          stats->memory += sizeof (BablFishPath) - sizeof (BablFish) +
+                           sizeof (BablList) + list->size * sizeof (Babl *);
+          stats->path_length = babl_list_size (list);
+          for (i = 0; i < stats->path_length &&
+                      i < BABL_FISH_STATS_MAX_PATH; i++)
+            {
+              stats->path[i]       = babl_get_name (list->items[i]);
+              stats->path_nsecs[i] = fish->fish_path.conversion_nsecs[i];
+            }
+        }
+        break;
+
+      case BABL_FISH_SIMPLE:
+        stats->memory += sizeof (BablFishSimple) - sizeof (BablFish);
+        stats->path_length = 1;
+        stats->path[0] = babl_get_name (BABL (fish->fish_simple.conversion));
+        break;
+
+      case BABL_FISH_LUT:
+        stats->memory += sizeof (BablFishLut) - sizeof (BablFish) +
+                         (long) fish->fish_lut.grid * fish->fish_lut.grid *
+                         fish->fish_lut.grid * fish->fish_lut.channels *
+                         sizeof (float);
+        break;
+
+      default:
+        break;
+    }
+  return 1;
+}
+
+typedef struct StatsSnapshot
+{
+  const Babl **fishes;
+  int          count;
+} StatsSnapshot;
+
+static int
+snapshot_each (Babl *babl,
+               void *data)
+{
+  StatsSnapshot *snapshot = data;
+
+  /* plain BablFish instances only mark pairs without a path */
+  if (babl->class_type != BABL_FISH)
+    snapshot->fishes[snapshot->count++] = babl;
+  return 0;
+}
+
+void
+babl_fish_stats_foreach (BablFishStatsFunc  func,
+                         void              *user_data)
+{
+  BablDb        *db = babl_fish_db ();
+  StatsSnapshot  snapshot;
+  BablFishStats  stats;
+  int            i;
+
+  /* the fishes are collected under the lock of the database, the callback
+   * is invoked without it, since it might create fishes.
+   */
+  babl_mutex_lock (db->mutex);
+  snapshot.fishes = babl_malloc (sizeof (Babl *) * (babl_db_count (db) + 1));
+  snapshot.count  = 0;
+  babl_db_each (db, snapshot_each, &snapshot);
+  babl_mutex_unlock (db->mutex);
+
+  for (i = 0; i < snapshot.count; i++)
+    if (babl_fish_get_stats (snapshot.fishes[i], &stats) &&
+        func (&stats, user_data))
+      break;
+
+  babl_free (snapshot.fishes);
+}
+
+typedef struct AdvisorReport
+{
+  BablFishStats *stats;
+  int            count;
+  int            size;
+} AdvisorReport;
+
+static int
+advisor_collect (const BablFishStats *stats,
+                 void                *data)
+{
+  AdvisorReport *report = data;
+
+  if (stats->pixels <= 0)
+    return 0;
+  if (report->count == report->size)
+    {
+      report->size  = report->size ? report->size * 2 : 64;
+      report->stats = babl_realloc (report->stats,
+                                    sizeof (BablFishStats) * report->size);
+    }
+  report->stats[report->count++] = *stats;
+  return 0;
+}
+
+/* most time spent first, the pixel count orders fishes that weren't timed */
+static int
+advisor_compare (const void *a,
+                 const void *b)
+{
+  const BablFishStats *sa = a;
+  const BablFishStats *sb = b;
+
+  if (sa->usecs != sb->usecs)
+    return sa->usecs < sb->usecs ? 1 : -1;
+  if (sa->pixels != sb->pixels)
+    return sa->pixels < sb->pixels ? 1 : -1;
+  return 0;
+}
+
+/* writes the fishes used so far ranked by the time spent in them, flagging
+ * the pairs which are worth a direct conversion: the ones falling back to
+ * the reference fish, and long paths, for which the share of time in each
+ * conversion is listed.
+ */
+void
+babl_fish_advise (FILE *file)
+{
+  AdvisorReport report = { NULL, 0, 0 };
+  long          total  = 0;
+  int           i, j;
+
+  babl_fish_stats_foreach (advisor_collect, &report);
+  if (report.count)
+    qsort (report.stats, report.count, sizeof (BablFishStats),
+           advisor_compare);
+
+  for (i = 0; i < report.count; i++)
+    total += report.stats[i].usecs;
+
+  fprintf (file, "babl fishes ranked by time spent:\n");
+  fprintf (file, "%4s %10s %6s %12s %8s  %s\n",
+           "rank", "msecs", "share", "pixels", "ns/px", "fish");
+
+  for (i = 0; i < report.count; i++)
+    {
+      const BablFishStats *stats = &report.stats[i];
+      long long            path_nsecs = 0;
+
+      fprintf (file, "%4i %10.1f %5.1f%% %12li %8.2f  %s to %s (%s)\n",
+               i + 1, stats->usecs / 1000.0,
+               total ? 100.0 * stats->usecs / total : 0.0,
+               stats->pixels, stats->ns_per_pixel,
+               stats->source, stats->destination, stats->kind);
+
+      if (stats->fish->class_type == BABL_FISH_REFERENCE &&
+          stats->fish->fish.source != stats->fish->fish.destination)
+        fprintf (file, "%4s   ! uses the reference fish, "
+                       "no path was found within the tolerance\n", "");
+      else if (stats->path_length > 2)
+        fprintf (file, "%4s   ! path of %i conversions\n", "",
+                 stats->path_length);
+
+      for (j = 0; j < stats->path_length && j < BABL_FISH_STATS_MAX_PATH; j++)
+        path_nsecs += stats->path_nsecs[j];
+      if (stats->path_length > 1)
+        for (j = 0; j < stats->path_length && j < BABL_FISH_STATS_MAX_PATH; j++)
+          fprintf (file, "%4s     %5.1f%%  %s\n", "",
+                   path_nsecs ? 100.0 * stats->path_nsecs[j] / path_nsecs : 0.0,
+                   stats->path[j]);
+    }
+
+  babl_free (report.stats);
+}
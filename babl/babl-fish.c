@@ -29,11 +29,13 @@ typedef struct _BablFindFish BablFindFish;
 typedef struct _BablFindFish
 {
   Babl       *fish_path;
+  Babl       *fish_lut;
   Babl       *fish_ref;
   Babl       *fish_fish;
   int        fishes;
   const Babl *source;
   const Babl *destination;
+  double     tolerance;
 } _BablFishFish;
 
 
@@ -55,7 +57,8 @@ find_fish_path (Babl *item,
 {
   BablFindFish *ffish = (BablFindFish *) data;
   if ((item->fish.source == ffish->source) &&
-      (item->fish.destination == ffish->destination))
+      (item->fish.destination == ffish->destination) &&
+      (item->fish.tolerance == ffish->tolerance))
     {
       if (item->instance.class_type == BABL_FISH_REFERENCE)
         {
@@ -67,12 +70,17 @@ find_fish_path (Babl *item,
           ffish->fish_path = item;
           ffish->fishes++;
         }
+      else if (item->instance.class_type == BABL_FISH_LUT)
+        {
+          ffish->fish_lut = item;
+          ffish->fishes++;
+        }
       else if (item->instance.class_type == BABL_FISH)
         {
           ffish->fish_fish = item;
           ffish->fishes++;
         }
-      if (ffish->fishes == 3)
+      if (ffish->fishes == 4)
         return 1;
     }
 
@@ -118,6 +126,9 @@ babl_conversion_find (const void *source,
 {
   void *data = (void*)destination;
 
+  /* formats nothing has been registered for yet have no list */
+  if (!BABL (source)->type.from_list)
+    return NULL;
   babl_list_each (BABL (source)->type.from_list, match_conversion, &data);
   if (data == (void*)destination) /* didn't change */
     return NULL;
@@ -138,6 +149,198 @@ babl_fish_get_id (const Babl *source,
   return id;
 }
 
+/* returns the fish babl_fish () would return for source and destination
+ * if it has already been created, without creating it, or NULL.
+ */
+Babl *
+babl_fish_lookup (const Babl *source,
+                  const Babl *destination)
+{
+  BablHashTable *id_htable = (babl_fish_db ())->id_hash;
+  int            hashval;
+  BablFindFish   ffish = {(Babl *) NULL,
+                          (Babl *) NULL,
+                          (Babl *) NULL,
+                          (Babl *) NULL,
+                          0,
+                          (Babl *) NULL,
+                          (Babl *) NULL,
+                          0.0};
+
+  ffish.source = source;
+  ffish.destination = destination;
+  hashval = babl_hash_by_int (id_htable, babl_fish_get_id (source, destination));
+
+  if (source == destination)
+    {
+      babl_hash_table_find (id_htable, hashval, find_memcpy_fish, (void *) &ffish);
+      return ffish.fish_ref;
+    }
+
+  babl_hash_table_find (id_htable, hashval, find_fish_path, (void *) &ffish);
+  if (ffish.fish_lut)
+    return ffish.fish_lut;
+  if (ffish.fish_path)
+    return ffish.fish_path;
+  return ffish.fish_ref;
+}
+
+/* returns the fish for source and destination with an error of at most
+ * tolerance, or of babl_legal_error () when tolerance is 0.0, creating it
+ * if needed
+ */
+static const Babl *
+fish_with_tolerance (const Babl           *source_format,
+                     const Babl           *destination_format,
+                     double                tolerance,
+                     const BablPathBudget *budget)
+{
+  int            hashval;
+  BablHashTable *id_htable;
+  BablFindFish   ffish = {(Babl *) NULL,
+                          (Babl *) NULL,
+                          (Babl *) NULL,
+                          (Babl *) NULL,
+                          0,
+                          (Babl *) NULL,
+                          (Babl *) NULL,
+                          0.0};
+
+  /* some vendor compilers can't compile non-constant elements of
+   * compound struct initializers
+   */
+  ffish.source = source_format;
+  ffish.destination = destination_format;
+  ffish.tolerance = tolerance;
+
+  id_htable = (babl_fish_db ())->id_hash;
+  hashval = babl_hash_by_int (id_htable, babl_fish_get_id (source_format, destination_format));
+
+  if (source_format == destination_format)
+    {
+      /* In the case of equal source and destination formats
+       * we will search through the fish database for reference fish
+       * to handle the memcpy */
+      babl_hash_table_find (id_htable, hashval, find_memcpy_fish, (void *) &ffish);
+    }
+  else
+    {
+      /* In the case of different source and destination formats
+       * we will search through the fish database for appropriate fish path
+       * to handle the conversion. In the case that preexistent
+       * fish path is found, we'll return it. In the case BABL_FISH
+       * instance with the same source/destination is found, we'll
+       * return reference fish.
+       * In the case neither fish path nor BABL_FISH path are found,
+       * we'll try to construct new fish path for requested
+       * source/destination. In the case new fish path is found, we'll
+       * return it, otherwise we'll create dummy BABL_FISH instance and
+       * insert it into the fish database to indicate non-existent fish
+       * path.
+       */
+      babl_hash_table_find (id_htable, hashval, find_fish_path, (void *) &ffish);
+
+      if (ffish.fish_lut)
+        {
+          /* an interpolating fish was found to be within tolerance
+           * and faster than the path */
+          BABL_TRACE (FISH_HIT, fish_hit, source_format, destination_format, 0);
+          return ffish.fish_lut;
+        }
+      if (ffish.fish_path)
+        {
+          /* we have found suitable fish path in the database, if its
+           * search ran out of budget it is continued by
+           * babl_fish_continue_searches () */
+          BABL_TRACE (FISH_HIT, fish_hit, source_format, destination_format, 0);
+          return ffish.fish_path;
+        }
+      if (!ffish.fish_fish)
+        {
+          /* we haven't tried to search for suitable path yet */
+          Babl *fish_path;
+          Babl *fish_lut = NULL;
+          int   incomplete;
+
+          BABL_TRACE (FISH_MISS, fish_miss, source_format, destination_format, 0);
+          fish_path = babl_fish_path_with_budget (source_format,
+                                                  destination_format,
+                                                  tolerance, budget,
+                                                  &incomplete);
+          /* tables are made for paths that are done improving */
+          if (!incomplete && !(fish_path && fish_path->fish_path.incomplete))
+            fish_lut  = babl_fish_lut (source_format, destination_format,
+                                       fish_path, tolerance);
+
+          if (fish_lut)
+            {
+              return fish_lut;
+            }
+          if (fish_path)
+            {
+              return fish_path;
+            }
+          else if (!incomplete)
+            {
+              /* there isn't a suitable path for requested formats,
+               * let's create a dummy BABL_FISH instance and insert
+               * it into the fish database to indicate that such path
+               * does not exist.
+               */
+              char         *name  = "X"; /* name does not matter */
+              BablFindFish  found = ffish;
+
+              /* another thread might have inserted one meanwhile */
+              babl_mutex_lock (babl_format_mutex);
+              found.fish_fish = NULL;
+              found.fishes    = 0;
+              babl_hash_table_find (id_htable, hashval, find_fish_path,
+                                    (void *) &found);
+              if (!found.fish_fish)
+                {
+                  Babl *fish = babl_calloc (1, sizeof (BablFish) + strlen (name) + 1);
+
+                  fish->class_type                = BABL_FISH;
+                  fish->instance.id               = babl_fish_get_id (source_format, destination_format);
+                  fish->instance.name             = ((char *) fish) + sizeof (BablFish);
+                  strcpy (fish->instance.name, name);
+                  fish->fish.source               = source_format;
+                  fish->fish.destination          = destination_format;
+                  fish->fish.tolerance            = tolerance;
+                  babl_db_insert (babl_fish_db (), fish);
+                }
+              babl_mutex_unlock (babl_format_mutex);
+            }
+        }
+    }
+
+  if (source_format != destination_format && tolerance == 0.0)
+    BABL_TRACE (REFERENCE_FALLBACK, reference_fallback,
+                source_format, destination_format, 0);
+
+  if (ffish.fish_ref)
+    {
+      /* we have already found suitable reference fish */
+      if (source_format == destination_format)
+        BABL_TRACE (FISH_HIT, fish_hit, source_format, destination_format, 0);
+      return ffish.fish_ref;
+    }
+  else if (tolerance > 0.0)
+    {
+      /* no path is within the larger tolerance, neither is one within
+       * the default tolerance, which yields the reference fish */
+      return fish_with_tolerance (source_format, destination_format, 0.0,
+                                  budget);
+    }
+  else
+    {
+      /* we have to create new reference fish */
+      if (source_format == destination_format)
+        BABL_TRACE (FISH_MISS, fish_miss, source_format, destination_format, 0);
+      return babl_fish_reference (source_format, destination_format);
+    }
+}
+
 const Babl *
 babl_fish (const void *source,
            const void *destination)
@@ -172,95 +375,84 @@ babl_fish (const void *source,
       return NULL;
     }
 
-  {
-    int            hashval;
-    BablHashTable *id_htable;
-    BablFindFish   ffish = {(Babl *) NULL,
-                            (Babl *) NULL,
-                            (Babl *) NULL,
-                            0,
-                            (Babl *) NULL,
-                            (Babl *) NULL};
-
-    /* some vendor compilers can't compile non-constant elements of
-     * compound struct initializers
-     */
-    ffish.source = source_format;
-    ffish.destination = destination_format;
-
-    id_htable = (babl_fish_db ())->id_hash;
-    hashval = babl_hash_by_int (id_htable, babl_fish_get_id (source_format, destination_format));
-
-    if (source_format == destination_format)
-      {
-        /* In the case of equal source and destination formats
-         * we will search through the fish database for reference fish
-         * to handle the memcpy */
-        babl_hash_table_find (id_htable, hashval, find_memcpy_fish, (void *) &ffish);
-      }
-    else
-      {
-        /* In the case of different source and destination formats
-         * we will search through the fish database for appropriate fish path
-         * to handle the conversion. In the case that preexistent
-         * fish path is found, we'll return it. In the case BABL_FISH
-         * instance with the same source/destination is found, we'll
-         * return reference fish.
-         * In the case neither fish path nor BABL_FISH path are found,
-         * we'll try to construct new fish path for requested
-         * source/destination. In the case new fish path is found, we'll
-         * return it, otherwise we'll create dummy BABL_FISH instance and
-         * insert it into the fish database to indicate non-existent fish
-         * path.
-         */
-        babl_hash_table_find (id_htable, hashval, find_fish_path, (void *) &ffish);
-
-        if (ffish.fish_path)
-          {
-            /* we have found suitable fish path in the database */
-            return ffish.fish_path;
-          }
-        if (!ffish.fish_fish)
-          {
-            /* we haven't tried to search for suitable path yet */
-            Babl *fish_path = babl_fish_path (source_format, destination_format);
-
-            if (fish_path)
-              {
-                return fish_path;
-              }
-            else
-              {
-                /* there isn't a suitable path for requested formats,
-                 * let's create a dummy BABL_FISH instance and insert
-                 * it into the fish database to indicate that such path
-                 * does not exist.
-                 */
-                char *name = "X"; /* name does not matter */
-                Babl *fish = babl_calloc (1, sizeof (BablFish) + strlen (name) + 1);
-
-                fish->class_type                = BABL_FISH;
-                fish->instance.id               = babl_fish_get_id (source_format, destination_format);
-                fish->instance.name             = ((char *) fish) + sizeof (BablFish);
-                strcpy (fish->instance.name, name);
-                fish->fish.source               = source_format;
-                fish->fish.destination          = destination_format;
-                babl_db_insert (babl_fish_db (), fish);
-              }
-          }
-      }
-
-    if (ffish.fish_ref)
-      {
-        /* we have already found suitable reference fish */
-        return ffish.fish_ref;
-      }
-    else
-      {
-        /* we have to create new reference fish */
-        return babl_fish_reference (source_format, destination_format);
-      }
-  }
+  return fish_with_tolerance (source_format, destination_format, 0.0, NULL);
+}
+
+/* tolerances are rounded down to a power of ten, keeping the number of
+ * fishes made for them, and the time spent making them, bounded
+ */
+static double
+tolerance_class (double tolerance)
+{
+  return pow (10.0, floor (log10 (tolerance) + 1e-9));
+}
+
+const Babl *
+babl_fish_with_tolerance (const void *source,
+                          const void *destination,
+                          double      tolerance)
+{
+  const Babl *source_format;
+  const Babl *destination_format;
+
+  babl_assert (source);
+  babl_assert (destination);
+
+  if (tolerance <= 0.0 ||
+      (tolerance = tolerance_class (tolerance)) <= babl_legal_error ())
+    return babl_fish (source, destination);
+
+  source_format = BABL_IS_BABL (source) ? source : babl_format ((char *) source);
+  if (!source_format)
+    {
+      babl_log ("args=(%p, %p) source format invalid", source, destination);
+      return NULL;
+    }
+
+  destination_format = BABL_IS_BABL (destination) ?
+                         destination : babl_format ((char *) destination);
+  if (!destination_format)
+    {
+      babl_log ("args=(%p, %p) destination format invalid", source, destination);
+      return NULL;
+    }
+
+  return fish_with_tolerance (source_format, destination_format, tolerance,
+                              NULL);
+}
+
+const Babl *
+babl_fish_with_budget (const void *source,
+                       const void *destination,
+                       double      msecs,
+                       int         candidates)
+{
+  const Babl     *source_format;
+  const Babl     *destination_format;
+  BablPathBudget  budget;
+
+  babl_assert (source);
+  babl_assert (destination);
+
+  source_format = BABL_IS_BABL (source) ? source : babl_format ((char *) source);
+  if (!source_format)
+    {
+      babl_log ("args=(%p, %p) source format invalid", source, destination);
+      return NULL;
+    }
+
+  destination_format = BABL_IS_BABL (destination) ?
+                         destination : babl_format ((char *) destination);
+  if (!destination_format)
+    {
+      babl_log ("args=(%p, %p) destination format invalid", source, destination);
+      return NULL;
+    }
+
+  budget.nsecs      = msecs > 0.0 ? msecs * 1000000 : 0;
+  budget.candidates = candidates > 0 ? candidates : 0;
+  return fish_with_tolerance (source_format, destination_format, 0.0,
+                              &budget);
 }
 
 BABL_CLASS_MINIMAL_IMPLEMENT (fish);
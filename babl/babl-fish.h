@@ -33,11 +33,16 @@ typedef struct
   const Babl     *destination;
 
   double          error;    /* the amount of noise introduced by the fish */
+  double          tolerance;/* the error it was allowed, 0.0 for the default
+                               of babl_legal_error () */
 
   /* instrumentation */
   int             processings; /* number of times the fish has been used */
   long            pixels;      /* number of pixels translates */
-  long            usecs;       /* usecs spent within this fish */
+  long            usecs;       /* usecs spent within this fish, estimated
+                                  from the sampled processings */
+  long            sampled_pixels; /* pixels of the timed processings */
+  long long       sampled_nsecs;  /* nanoseconds spent in them */
 } BablFish;
 
 /* BablFishSimple is the simplest type of fish, wrapping a single
@@ -68,8 +73,47 @@ typedef struct
   double           cost;   /* number of  ticks *10 + chain_length */
   double           loss;   /* error introduced */
   BablList         *conversion_list;
+  long long        *conversion_nsecs; /* sampled time in each conversion */
+  int               incomplete;       /* the search ran out of budget */
+  int               search_length;    /* length of the paths it stopped at */
+  int               search_skip;      /* paths of that length it went past */
+  int               search_conversions; /* conversions registered then */
+  BablList        **retired;          /* conversion lists replaced by later
+                                         searches, other threads might still
+                                         be processing with */
+  int               retired_count;
 } BablFishPath;
 
+/* the limits of a path search, 0 for no limit */
+typedef struct
+{
+  long long        nsecs;      /* wall time */
+  int              candidates; /* candidate paths measured */
+} BablPathBudget;
+
+/* BablFishLut
+ *
+ * A BablFishLut approximates an expensive conversion between models
+ * of three component formats by tetrahedral interpolation in a regular
+ * grid of samples taken from the exact conversion. The source is first
+ * brought to a float format of the source model, the grid yields a float
+ * format of the destination model which is converted to the destination.
+ * Float sources outside of the grid are converted by the exact fish.
+ */
+typedef struct
+{
+  BablFish         fish;
+  int              grid;     /* samples along each axis */
+  int              channels; /* components stored per sample */
+  float            offset[3];/* maps the input components to grid units */
+  float            scale[3];
+  float           *lut;
+  const Babl      *to_lut;   /* source to lut input, NULL if the same */
+  const Babl      *from_lut; /* lut output to destination, NULL if the same */
+  const Babl      *exact;    /* for pixels outside of the grid, NULL when the
+                                grid spans all the source can encode */
+} BablFishLut;
+
 /* BablFishReference
  *
  * A BablFishReference is not intended to be fast, thus the algorithm
@@ -367,6 +367,7 @@ babl_format_new (const void *first_arg,
               case BABL_FISH_REFERENCE:
               case BABL_FISH_SIMPLE:
               case BABL_FISH_PATH:
+              case BABL_FISH_LUT:
               case BABL_IMAGE:
               case BABL_EXTENSION:
                 babl_log ("%s unexpected",
@@ -572,6 +573,8 @@ babl_format_loss (const Babl *babl)
 
   if (babl->format.loss != -1.0)
     return babl->format.loss;
+  if (babl_snapshot_format ((Babl *) babl))
+    return babl->format.loss;
 
   fmt       = babl;
   fish_to   = babl_fish_reference (ref_fmt, fmt);
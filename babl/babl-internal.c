@@ -38,6 +38,7 @@ static const char *class_names[] =
   "BablFishReference",
   "BablFishSimple",
   "BablFishPath",
+  "BablFishLut",
   "BablImage",
   "BablExtenstion",
   "BablSky"
@@ -77,6 +78,7 @@ babl_die (void)
 
 
 BablMutex *babl_format_mutex;
+BablMutex *babl_reference_mutex;
 #if BABL_DEBUG_MEM
 BablMutex *babl_debug_mutex;
 #endif
@@ -87,6 +89,7 @@ babl_internal_init (void)
   babl_set_malloc (malloc);
   babl_set_free (free);
   babl_format_mutex = babl_mutex_new ();
+  babl_reference_mutex = babl_mutex_new ();
 #if BABL_DEBUG_MEM
   babl_debug_mutex = babl_mutex_new ();
 #endif
@@ -96,6 +99,7 @@ void
 babl_internal_destroy (void)
 {
   babl_mutex_destroy (babl_format_mutex);
+  babl_mutex_destroy (babl_reference_mutex);
 #if BABL_DEBUG_MEM
   babl_mutex_destroy (babl_debug_mutex);
 #endif
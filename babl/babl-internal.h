@@ -51,6 +51,7 @@
 #include "babl-memory.h"
 #include "babl-mutex.h"
 #include "babl-cpuaccel.h"
+#include "babl-trace.h"
 
 /* fallback to floor function when rint is not around */
 #ifndef HAVE_RINT
@@ -80,16 +81,89 @@ long     babl_fish_reference_process    (const Babl *babl,
                                          const char *source,
                                          char       *destination,
                                          long        n);
+long     babl_fish_process              (Babl           *babl,
+                                         const void     *source,
+                                         void           *destination,
+                                         long            n,
+                                         int             timed);
 
 Babl   * babl_fish_reference            (const Babl     *source,
                                          const Babl     *destination);
 Babl   * babl_fish_simple               (BablConversion *conversion);
 void     babl_fish_stats                (FILE           *file);
+void     babl_fish_advise               (FILE           *file);
 Babl   * babl_fish_path                 (const Babl     *source,
+                                         const Babl     *destination,
+                                         double          tolerance);
+Babl   * babl_fish_path_with_budget     (const Babl     *source,
+                                         const Babl     *destination,
+                                         double          tolerance,
+                                         const BablPathBudget *budget,
+                                         int            *incomplete);
+const BablPathBudget *
+         babl_path_budget               (void);
+void     babl_fish_path_deinit          (void);
+Babl   * babl_fish_lut                  (const Babl     *source,
+                                         const Babl     *destination,
+                                         const Babl     *fish_path,
+                                         double          tolerance);
+long     babl_fish_lut_process          (const Babl     *babl,
+                                         const void     *source,
+                                         void           *destination,
+                                         long            n);
+double   babl_legal_error               (void);
+int      babl_path_working_set          (void);
+Babl   * babl_conversion_table          (const Babl     *source,
                                          const Babl     *destination);
+int      babl_conversion_is_table       (const Babl     *conversion);
+void     babl_conversion_table_deinit   (void);
+void     babl_fish_profile_save         (void);
+
+void     babl_snapshot_load             (void);
+int      babl_snapshot_conversion       (BablConversion *conversion);
+int      babl_snapshot_format           (Babl           *format);
+void     babl_snapshot_save             (void);
+void     babl_snapshot_destroy          (void);
+
+void     babl_startup_profile_init      (void);
+void     babl_startup_phase_begin       (const char     *name);
+void     babl_startup_phase_end         (void);
+void     babl_startup_profile_destroy   (void);
+
+void     babl_path_memo_insert          (const Babl     *source,
+                                         const Babl     *destination,
+                                         double          tolerance,
+                                         BablList       *path);
+BablList *babl_path_memo_lookup         (const Babl     *source,
+                                         const Babl     *destination,
+                                         double          tolerance,
+                                         int            *searched);
+long     babl_path_memo_hits            (void);
+void     babl_path_memo_destroy         (void);
+
+const void *babl_path_test_buffer       (const Babl     *format);
+const void *babl_path_reference         (const Babl     *source,
+                                         const Babl     *destination,
+                                         const double  **rgba,
+                                         long long      *nsecs);
+const void *babl_conversion_test_buffer (const Babl     *format);
+const void *babl_conversion_reference   (const Babl     *source,
+                                         const Babl     *destination,
+                                         const double  **rgba);
+long     babl_path_buffers_made         (void);
+void     babl_path_buffers_destroy      (void);
+
+void     babl_warmup_stats              (int            *measuring,
+                                         long           *buffers);
+
+int      babl_path_costs_static         (void);
+double   babl_path_costs_conversion     (const Babl     *conversion);
+const char *babl_conversion_stable_name (const Babl     *conversion);
 
 int      babl_fish_get_id               (const Babl     *source,
                                          const Babl     *destination);
+Babl   * babl_fish_lookup               (const Babl     *source,
+                                         const Babl     *destination);
 
 double   babl_format_loss               (const Babl     *babl);
 Babl   * babl_image_from_linear         (char           *buffer,
@@ -216,6 +290,7 @@ babl_fatal (const char *format, ...)
 extern int   babl_hmpf_on_name_lookups;
 extern int   babl_in_fish_path;
 extern BablMutex *babl_format_mutex;
+extern BablMutex *babl_reference_mutex; /* creation of reference and simple fishes */
 
 #define BABL_DEBUG_MEM 0
 #if BABL_DEBUG_MEM
@@ -247,6 +322,7 @@ void                                                          \
 babl_##klass##_class_for_each (BablEachFunction  each_fun,    \
                                void             *user_data)   \
 {                                                             \
+  babl_extension_load_pending ();                             \
   babl_db_each (db, each_fun, user_data);                     \
 }                                                             \
 
@@ -264,6 +340,8 @@ babl_##klass (const char *name)                               \
     }                                                         \
   babl = babl_db_exist_by_name (db, name);                    \
                                                               \
+  if (!babl && babl_extension_load_providing (#klass, name))  \
+    babl = babl_db_exist_by_name (db, name);                  \
   if (!babl)                                                  \
     {                                                         \
       babl_fatal ("%s(\"%s\"): not found", G_STRFUNC, name);  \
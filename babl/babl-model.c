@@ -73,6 +73,7 @@ model_new (const char     *name,
   memcpy (babl->model.component, component, sizeof (BablComponent *) * components);
 
   babl->model.from_list  = NULL;
+  babl->model.palette    = 0;
   return babl;
 }
 
@@ -148,6 +149,7 @@ babl_model_new (void *first_argument,
               case BABL_FISH_SIMPLE:
               case BABL_FISH_REFERENCE:
               case BABL_FISH_PATH:
+              case BABL_FISH_LUT:
               case BABL_IMAGE:
               case BABL_EXTENSION:
                 babl_log ("%s unexpected", babl_class_name (babl->class_type));
@@ -30,6 +30,7 @@ typedef struct
   BablType       **type; /*< must be doubles,
                              used here for convenience in code */
   void            *data; /* used for palette */
+  int              palette;
 } BablModel;
 
 #endif
@@ -23,6 +23,9 @@
 #include <string.h>
 #include "babl-mutex.h"
 
+/* mutexes are recursive, like critical sections are on windows, a thread
+ * holding one can lock it again, as when loading an extension while
+ * searching a path */
 BablMutex  *
 babl_mutex_new (void)
 {
@@ -30,7 +33,12 @@ babl_mutex_new (void)
 #ifdef _WIN32
   InitializeCriticalSection (mutex);
 #else
-  pthread_mutex_init (mutex, NULL);
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init (&attr);
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init (mutex, &attr);
+  pthread_mutexattr_destroy (&attr);
 #endif
   return mutex;
 }
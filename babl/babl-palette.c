@@ -17,6 +17,7 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
@@ -26,7 +27,23 @@
 #include "babl.h"
 #include "babl-memory.h"
 
-#define HASH_TABLE_SIZE 1111
+/* The nearest color lookups of babl_palette_lookup are memoized in a
+ * direct mapped cache shared by all threads. Each entry packs a valid bit,
+ * the bits of the scrambled pixel value not implied by the slot, and the
+ * palette index into one 32bit word, thus entries are read and written
+ * atomically and racing threads at worst evict each others entries.
+ */
+#define CACHE_VALID          0x80000000u
+#define CACHE_MIN_BITS       12
+#define CACHE_MAX_BITS       16
+
+#if defined(__GNUC__)
+#define cache_load(entry)        __atomic_load_n ((entry), __ATOMIC_RELAXED)
+#define cache_store(entry, val)  __atomic_store_n ((entry), (val), __ATOMIC_RELAXED)
+#else
+#define cache_load(entry)        (*(volatile uint32_t *) (entry))
+#define cache_store(entry, val)  (*(volatile uint32_t *) (entry) = (val))
+#endif
 
 /* A default palette, containing standard ANSI / EGA colors
  *
@@ -52,6 +69,22 @@ static unsigned char defpal_data[4*16] =
 };
 static double defpal_double[4*8*16];
 
+/* A node of the k-d tree used for nearest color searches, the tree is
+ * stored implicitly; the node splitting the range [lo,hi) is found at
+ * (lo+hi)/2, with the entries of the lower half before it and the entries
+ * of the upper half after it.
+ */
+typedef struct BablPaletteNode
+{
+  double coord[3]; /* r, g and b of the palette entry */
+  int    index;    /* index of the palette entry */
+  int    axis;     /* component this node splits its range on */
+} BablPaletteNode;
+
+static BablPaletteNode defpal_tree_double[16];
+static BablPaletteNode defpal_tree_u8[16];
+static uint32_t        defpal_cache[1 << CACHE_MIN_BITS];
+
 
 typedef struct BablPalette
 {
@@ -60,56 +93,263 @@ typedef struct BablPalette
   unsigned char *data;  /* one linear segment of all the pixels representing the palette, in   order */
   double        *data_double;
   unsigned char *data_u8;
-  int          hash[HASH_TABLE_SIZE];
-  unsigned int hashpx[HASH_TABLE_SIZE];
+  BablPaletteNode *tree_double; /* k-d tree over data_double */
+  BablPaletteNode *tree_u8;     /* k-d tree over data_u8 */
+  uint32_t     expand_u8[256];     /* RGBA u8 for every possible u8 index, with
+                                      out of range indices clamped to the last
+                                      entry, for expanding without branches */
+  float        expand_float[256*4];/* the same as RGBA float */
+  uint32_t    *cache;      /* memoized lookups, see CACHE_VALID */
+  int          cache_bits; /* log2 of the number of cache entries */
 } BablPalette;
 
 static void
-babl_palette_reset_hash (BablPalette *pal)
+palette_tree_swap (BablPaletteNode *a,
+                   BablPaletteNode *b)
+{
+  BablPaletteNode tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+/* partially sorts nodes[lo..hi) on axis, such that nodes[nth] ends up
+ * where it would be if sorted, with no larger values before it and no
+ * smaller values after it.
+ */
+static void
+palette_tree_select (BablPaletteNode *nodes,
+                     int              lo,
+                     int              hi,
+                     int              nth,
+                     int              axis)
+{
+  while (hi - lo > 1)
+    {
+      int    i;
+      int    store = lo;
+      double pivot;
+
+      palette_tree_swap (&nodes[(lo + hi) / 2], &nodes[hi - 1]);
+      pivot = nodes[hi - 1].coord[axis];
+
+      for (i = lo; i < hi - 1; i++)
+        if (nodes[i].coord[axis] < pivot)
+          palette_tree_swap (&nodes[i], &nodes[store++]);
+      palette_tree_swap (&nodes[store], &nodes[hi - 1]);
+
+      if (store == nth)
+        return;
+      else if (nth < store)
+        hi = store;
+      else
+        lo = store + 1;
+    }
+}
+
+static void
+palette_tree_build_range (BablPaletteNode *nodes,
+                          int              lo,
+                          int              hi)
+{
+  double min[3], max[3];
+  int    axis = 0;
+  int    mid  = (lo + hi) / 2;
+  int    i, c;
+
+  if (hi - lo <= 0)
+    return;
+
+  for (c = 0; c < 3; c++)
+    min[c] = max[c] = nodes[lo].coord[c];
+  for (i = lo + 1; i < hi; i++)
+    for (c = 0; c < 3; c++)
+      {
+        if (nodes[i].coord[c] < min[c]) min[c] = nodes[i].coord[c];
+        if (nodes[i].coord[c] > max[c]) max[c] = nodes[i].coord[c];
+      }
+  /* split along the component with the largest spread */
+  for (c = 1; c < 3; c++)
+    if (max[c] - min[c] > max[axis] - min[axis])
+      axis = c;
+
+  palette_tree_select (nodes, lo, hi, mid, axis);
+  nodes[mid].axis = axis;
+
+  palette_tree_build_range (nodes, lo, mid);
+  palette_tree_build_range (nodes, mid + 1, hi);
+}
+
+static void
+palette_tree_build_double (BablPaletteNode *nodes,
+                           const double    *data,
+                           int              count)
+{
+  int i;
+  for (i = 0; i < count; i++)
+    {
+      nodes[i].coord[0] = data[i * 4 + 0];
+      nodes[i].coord[1] = data[i * 4 + 1];
+      nodes[i].coord[2] = data[i * 4 + 2];
+      nodes[i].index    = i;
+    }
+  palette_tree_build_range (nodes, 0, count);
+}
+
+static void
+palette_tree_build_u8 (BablPaletteNode     *nodes,
+                       const unsigned char *data,
+                       int                  count)
 {
   int i;
-  for (i = 0; i < HASH_TABLE_SIZE; i++)
+  for (i = 0; i < count; i++)
     {
-      pal->hashpx[i] = ((255 << 16) | (255 << 8) | 255) + 11; /* non existant pixel */
-      pal->hash[i] = -1;
+      nodes[i].coord[0] = data[i * 4 + 0];
+      nodes[i].coord[1] = data[i * 4 + 1];
+      nodes[i].coord[2] = data[i * 4 + 2];
+      nodes[i].index    = i;
     }
+  palette_tree_build_range (nodes, 0, count);
+}
+
+/* Finds the palette entry closest to px, the squared distance is computed
+ * in the same order as an exhaustive search would, and of multiple equally
+ * close entries the lowest index wins, or the highest one if prefer_last
+ * is set; thus yielding exactly the same entry as a linear scan.
+ */
+static void
+palette_tree_search (const BablPaletteNode *nodes,
+                     int                    lo,
+                     int                    hi,
+                     const double          *px,
+                     int                    prefer_last,
+                     double                *best_diff,
+                     int                   *best_idx)
+{
+  while (hi - lo > 0)
+    {
+      int                    mid  = (lo + hi) / 2;
+      const BablPaletteNode *node = &nodes[mid];
+      double                 plane;
+      double                 diff;
+
+      diff = (node->coord[0] - px[0]) * (node->coord[0] - px[0]) +
+             (node->coord[1] - px[1]) * (node->coord[1] - px[1]) +
+             (node->coord[2] - px[2]) * (node->coord[2] - px[2]);
+      if (diff < *best_diff ||
+          (diff == *best_diff &&
+           (prefer_last ? node->index > *best_idx
+                        : node->index < *best_idx)))
+        {
+          *best_diff = diff;
+          *best_idx  = node->index;
+        }
+
+      plane = px[node->axis] - node->coord[node->axis];
+
+      /* descend into the near half, the far half only needs to be visited
+       * when it can contain an entry as close as the best one so far.
+       */
+      if (plane < 0)
+        {
+          palette_tree_search (nodes, lo, mid, px, prefer_last,
+                               best_diff, best_idx);
+          if (plane * plane > *best_diff)
+            return;
+          lo = mid + 1;
+        }
+      else
+        {
+          palette_tree_search (nodes, mid + 1, hi, px, prefer_last,
+                               best_diff, best_idx);
+          if (plane * plane > *best_diff)
+            return;
+          hi = mid;
+        }
+    }
+}
+
+static void
+babl_palette_init_expand (BablPalette *pal)
+{
+  float *data_float;
+  int    i;
+
+  if (pal->count <= 0)
+    {
+      memset (pal->expand_u8, 0, sizeof (pal->expand_u8));
+      memset (pal->expand_float, 0, sizeof (pal->expand_float));
+      return;
+    }
+
+  data_float = babl_malloc (4 * sizeof (float) * pal->count);
+  babl_process (babl_fish (pal->format, babl_format ("RGBA float")),
+                pal->data, data_float, pal->count);
+
+  for (i = 0; i < 256; i++)
+    {
+      int idx = i < pal->count ? i : pal->count - 1;
+
+      memcpy (&pal->expand_u8[i], pal->data_u8 + idx * 4, 4);
+      memcpy (&pal->expand_float[i * 4], data_float + idx * 4,
+              sizeof (float) * 4);
+    }
+
+  babl_free (data_float);
+}
+
+/* the cache is larger for larger palettes, since for those a miss is
+ * more expensive.
+ */
+static int
+babl_palette_cache_bits (int count)
+{
+  if (count <= 16)
+    return CACHE_MIN_BITS;
+  else if (count <= 64)
+    return CACHE_MIN_BITS + 2;
+  return CACHE_MAX_BITS;
+}
+
+static void
+babl_palette_reset_hash (BablPalette *pal)
+{
+  memset (pal->cache, 0, sizeof (uint32_t) << pal->cache_bits);
 }
 
 static int
 babl_palette_lookup (BablPalette *pal, int r, int g, int b, int a)
 {
-  unsigned int pixel      = (r << 16) | (g << 8) | b;
-  int          hash_index = pixel % HASH_TABLE_SIZE;
-  int          idx = pal->hash[hash_index];
-  
-  if (idx >= 0 &&
-      pal->hashpx[hash_index] == pixel)
+  /* multiplying with an odd number modulo 2^24 scrambles the pixel
+   * without collisions, the top bits pick the slot and the rest is
+   * kept in the entry to tell pixels sharing a slot apart.
+   */
+  uint32_t pixel    = (r << 16) | (g << 8) | b;
+  uint32_t mixed    = (pixel * 0x9e3779b1u) & 0xffffff;
+  int      tag_bits = 24 - pal->cache_bits;
+  uint32_t slot     = mixed >> tag_bits;
+  uint32_t tag      = mixed & ((1u << tag_bits) - 1);
+  uint32_t entry    = cache_load (&pal->cache[slot]);
+
+  if ((entry & CACHE_VALID) &&
+      ((entry >> 8) & ((1u << tag_bits) - 1)) == tag)
     {
-      return idx;
+      return entry & 0xff;
     }
   else
     {
-      int best_idx = 0;
-      int best_diff = INT_MAX;
+      int    best_idx  = 0;
+      double best_diff = INT_MAX;
+      double px[3];
 
-      for (idx = 0; idx < pal->count; idx++)
-        {
-          unsigned char *palpx = pal->data_u8 + idx * 4;
-          int pr = palpx[0];
-          int pg = palpx[1];
-          int pb = palpx[2];
-
-          int diff = (r - pr) * (r - pr) +
-                     (g - pg) * (g - pg) +
-                     (b - pb) * (b - pb);
-          if (diff < best_diff)
-            {
-              best_diff = diff;
-              best_idx  = idx;
-            }
-        }
-      pal->hash[hash_index] = best_idx;
-      pal->hashpx[hash_index] = pixel;
+      px[0] = r;
+      px[1] = g;
+      px[2] = b;
+
+      palette_tree_search (pal->tree_u8, 0, pal->count, px, 0,
+                           &best_diff, &best_idx);
+
+      cache_store (&pal->cache[slot],
+                   CACHE_VALID | (tag << 8) | (best_idx & 0xff));
       return best_idx;
     }
   return 0;
@@ -126,6 +366,10 @@ static BablPalette *make_pal (const Babl *format, const void *data, int count)
   pal->data = babl_malloc (bpp * count);
   pal->data_double = babl_malloc (4 * sizeof(double) * count);
   pal->data_u8 = babl_malloc (4 * sizeof(char) * count);
+  pal->tree_double = babl_malloc (sizeof (BablPaletteNode) * count);
+  pal->tree_u8 = babl_malloc (sizeof (BablPaletteNode) * count);
+  pal->cache_bits = babl_palette_cache_bits (count);
+  pal->cache = babl_malloc (sizeof (uint32_t) << pal->cache_bits);
   memcpy (pal->data, data, bpp * count);
 
   babl_process (babl_fish (format, babl_format ("RGBA double")),
@@ -133,6 +377,10 @@ static BablPalette *make_pal (const Babl *format, const void *data, int count)
   babl_process (babl_fish (format, babl_format ("RGBA u8")),
                 data, pal->data_u8, count);
 
+  palette_tree_build_double (pal->tree_double, pal->data_double, count);
+  palette_tree_build_u8 (pal->tree_u8, pal->data_u8, count);
+
+  babl_palette_init_expand (pal);
   babl_palette_reset_hash (pal);
 
   return pal;
@@ -143,6 +391,9 @@ static void babl_palette_free (BablPalette *pal)
   babl_free (pal->data);
   babl_free (pal->data_double);
   babl_free (pal->data_u8);
+  babl_free (pal->tree_double);
+  babl_free (pal->tree_u8);
+  babl_free (pal->cache);
   babl_free (pal);
 }
 
@@ -162,10 +413,18 @@ static BablPalette *default_palette (void)
   pal.data = defpal_data;
   pal.data_double = defpal_double;
   pal.data_u8 = defpal_data;
+  pal.tree_double = defpal_tree_double;
+  pal.tree_u8 = defpal_tree_u8;
+  pal.cache = defpal_cache;
+  pal.cache_bits = CACHE_MIN_BITS;
 
   babl_process (babl_fish (pal.format, babl_format ("RGBA double")),
                 pal.data, pal.data_double, pal.count);
 
+  palette_tree_build_double (pal.tree_double, pal.data_double, pal.count);
+  palette_tree_build_u8 (pal.tree_u8, pal.data_u8, pal.count);
+
+  babl_palette_init_expand (&pal);
   babl_palette_reset_hash (&pal);
   return &pal;
 }
@@ -180,28 +439,14 @@ rgba_to_pal (char *src,
   BablPalette *pal = *palptr;
   while (n--)
     {
-      int idx;
-
       int best_idx = 0;
       double best_diff = 100000;
       double *srcf;
 
       srcf = ((double *) src);
 
-      for (idx = 0; idx<pal->count; idx++)
-        {
-          double diff;
-          double *palpx = ((double *)pal->data_double) + idx * 4;
-
-          diff = (palpx[0] - srcf[0]) * (palpx[0] - srcf[0]) +
-                 (palpx[1] - srcf[1]) * (palpx[1] - srcf[1]) +
-                 (palpx[2] - srcf[2]) * (palpx[2] - srcf[2]);
-          if (diff <= best_diff)
-            {
-              best_diff = diff;
-              best_idx = idx;
-            }
-        }
+      palette_tree_search (pal->tree_double, 0, pal->count, srcf, 1,
+                           &best_diff, &best_idx);
 
       ((double *) dst)[0] = best_idx / 255.5;
 
@@ -223,8 +468,6 @@ rgba_to_pala (char *src,
   assert(pal);
   while (n--)
     {
-      int idx;
-
       int best_idx = 0;
       double best_diff = 100000;
       double *srcf;
@@ -233,20 +476,8 @@ rgba_to_pala (char *src,
       srcf = ((double *) src);
       alpha = srcf[3];
 
-      for (idx = 0; idx<pal->count; idx++)
-        {
-          double diff;
-          double *palpx = ((double *)pal->data_double) + idx * 4;
-
-          diff = (palpx[0] - srcf[0]) * (palpx[0] - srcf[0]) +
-                 (palpx[1] - srcf[1]) * (palpx[1] - srcf[1]) +
-                 (palpx[2] - srcf[2]) * (palpx[2] - srcf[2]);
-          if (diff <= best_diff)
-            {
-              best_diff = diff;
-              best_idx = idx;
-            }
-        }
+      palette_tree_search (pal->tree_double, 0, pal->count, srcf, 1,
+                           &best_diff, &best_idx);
 
       ((double *) dst)[0] = best_idx / 255.5;
       ((double *) dst)[1] = alpha;
@@ -336,8 +567,8 @@ rgba_u8_to_pal (unsigned char *src,
 }
 
 static long
-rgba_u8_to_pal_a (char *src,
-                  char *dst,
+rgba_u8_to_pal_a (unsigned char *src,
+                  unsigned char *dst,
                   long  n,
                   void *src_model_data)
 {
@@ -358,58 +589,118 @@ rgba_u8_to_pal_a (char *src,
 }
 
 static long
-pal_u8_to_rgba_u8 (char *src,
-                   char *dst,
-                   long  n,
-                   void *src_model_data)
+pal_u8_to_rgba_u8 (unsigned char *src,
+                   unsigned char *dst,
+                   long           n,
+                   void          *src_model_data)
 {
   BablPalette **palptr = src_model_data;
   BablPalette *pal;
+  const uint32_t *expand;
+  long i = 0;
   assert (palptr);
   pal = *palptr;
   assert(pal);
-  while (n--)
+  expand = pal->expand_u8;
+
+  /* whole 32bit pixels are copied out of the expansion table, unrolled
+   * to keep several independent loads in flight
+   */
+  for (; i + 4 <= n; i += 4)
     {
-      int idx = (((unsigned char *) src)[0]);
-      unsigned char *palpx;
+      uint32_t p0 = expand[src[i + 0]];
+      uint32_t p1 = expand[src[i + 1]];
+      uint32_t p2 = expand[src[i + 2]];
+      uint32_t p3 = expand[src[i + 3]];
+
+      memcpy (dst + (i + 0) * 4, &p0, 4);
+      memcpy (dst + (i + 1) * 4, &p1, 4);
+      memcpy (dst + (i + 2) * 4, &p2, 4);
+      memcpy (dst + (i + 3) * 4, &p3, 4);
+    }
+  for (; i < n; i++)
+    memcpy (dst + i * 4, &expand[src[i]], 4);
 
-      if (idx < 0) idx = 0;
-      if (idx >= pal->count) idx = pal->count-1;
+  return n;
+}
+
+static long
+pala_u8_to_rgba_u8 (unsigned char *src,
+                    unsigned char *dst,
+                    long           n,
+                    void          *src_model_data)
+{
+  BablPalette **palptr = src_model_data;
+  BablPalette *pal;
+  const uint32_t *expand;
+  long i;
+  assert (palptr);
+  pal = *palptr;
+  assert(pal);
+  expand = pal->expand_u8;
+
+  for (i = 0; i < n; i++)
+    {
+      unsigned int t;
 
-      palpx = ((unsigned char*)pal->data_u8) + idx * 4;
-      memcpy (dst, palpx, sizeof(char)*4);
+      memcpy (dst, &expand[src[0]], 4);
+      /* rounded dst[3] * src[1] / 255 */
+      t = dst[3] * src[1] + 128;
+      dst[3] = (t + (t >> 8)) >> 8;
 
-      src += sizeof (char) * 1;
+      src += sizeof (char) * 2;
       dst += sizeof (char) * 4;
     }
   return n;
 }
 
 static long
-pala_u8_to_rgba_u8 (char *src,
-                    char *dst,
-                    long  n,
-                    void *src_model_data)
+pal_u8_to_rgba_float (unsigned char *src,
+                      unsigned char *dst,
+                      long           n,
+                      void          *src_model_data)
 {
   BablPalette **palptr = src_model_data;
   BablPalette *pal;
+  const float *expand;
+  float       *dstf = (float *) dst;
+  long i;
   assert (palptr);
   pal = *palptr;
   assert(pal);
-  while (n--)
+  expand = pal->expand_float;
+
+  for (i = 0; i < n; i++)
     {
-      int idx = (((unsigned char *) src)[0]);
-      unsigned char *palpx;
+      memcpy (dstf, expand + src[i] * 4, sizeof (float) * 4);
+      dstf += 4;
+    }
+  return n;
+}
 
-      if (idx < 0) idx = 0;
-      if (idx >= pal->count) idx = pal->count-1;
+static long
+pala_u8_to_rgba_float (unsigned char *src,
+                       unsigned char *dst,
+                       long           n,
+                       void          *src_model_data)
+{
+  BablPalette **palptr = src_model_data;
+  BablPalette *pal;
+  const float *expand;
+  float       *dstf = (float *) dst;
+  long i;
+  assert (palptr);
+  pal = *palptr;
+  assert(pal);
+  expand = pal->expand_float;
 
-      palpx = ((unsigned char*)pal->data_u8) + idx * 4;
-      memcpy (dst, palpx, sizeof(char)*4);
-      dst[3] = (dst[3] * src[1]) >> 8;
+  for (i = 0; i < n; i++)
+    {
+      memcpy (dstf, expand + src[0] * 4, sizeof (float) * 4);
+      dstf[3] *= src[1] / 255.0f;
 
-      src += sizeof (char) * 2;
-      dst += sizeof (char) * 4;
+      src  += sizeof (char) * 2;
+      dstf += 4;
     }
   return n;
 }
@@ -518,6 +809,8 @@ const Babl *babl_new_palette (const char  *name,
 
   f_pal_a_u8->format.palette = 1;
   f_pal_u8->format.palette = 1;
+  ((Babl *) model)->model.palette = 1;
+  ((Babl *) model_no_alpha)->model.palette = 1;
 
   babl_conversion_new (
      model,
@@ -580,6 +873,20 @@ const Babl *babl_new_palette (const char  *name,
      "data", palptr,
      NULL);
 
+  babl_conversion_new (
+     f_pal_u8,
+     babl_format ("RGBA float"),
+     "linear", pal_u8_to_rgba_float,
+     "data", palptr,
+     NULL);
+
+  babl_conversion_new (
+     f_pal_a_u8,
+     babl_format ("RGBA float"),
+     "linear", pala_u8_to_rgba_float,
+     "data", palptr,
+     NULL);
+
   babl_conversion_new (
      babl_format ("RGBA u8"),
      f_pal_a_u8,
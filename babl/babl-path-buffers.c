@@ -0,0 +1,282 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* The path test pixels converted to each format, and what the reference
+ * fish makes of them for each pair of formats, are made once and shared by
+ * all the path searches and conversion tables measured after, instead of
+ * being made again for every candidate path. The same is kept of the
+ * conversion test pixels for measuring the errors of conversions.
+ *
+ * The buffers are made while holding babl_format_mutex and not changed
+ * after, they can be read without it. The buffers of palette formats are
+ * made again every time, their palette can change, they are only to be
+ * used while holding babl_format_mutex.
+ *
+ * The reference fishes making them are not counted as processing pixels.
+ */
+
+#include "config.h"
+#include "babl-internal.h"
+#include "babl-ref-pixels.h"
+
+typedef enum
+{
+  PATH_PIXELS,
+  CONVERSION_PIXELS
+} PixelSet;
+
+typedef struct PathBuffer
+{
+  PixelSet    set;
+  const Babl *source;
+  const Babl *destination;  /* NULL for the test pixels in source */
+  void       *pixels;
+  double     *rgba;         /* pixels as RGBA double */
+  long long   nsecs;        /* the reference fish took making pixels */
+} PathBuffer;
+
+static PathBuffer **buffers       = NULL;
+static int          buffers_size  = 0;  /* a power of two */
+static int          buffers_count = 0;
+static long         buffers_made  = 0;
+
+static const Babl *
+rgba_double (void)
+{
+  return babl_format_new (babl_model ("RGBA"),
+                          babl_type ("double"),
+                          babl_component ("R"),
+                          babl_component ("G"),
+                          babl_component ("B"),
+                          babl_component ("A"),
+                          NULL);
+}
+
+static PathBuffer **
+buffer_slot (PixelSet    set,
+             const Babl *source,
+             const Babl *destination)
+{
+  size_t       key = ((size_t) source * 31 + (size_t) destination) * 3 + set;
+  unsigned int i;
+
+  key ^= key >> 15;
+  key *= 0x2c1b3c6d;
+  key ^= key >> 12;
+  i = (unsigned int) key & (buffers_size - 1);
+
+  while (buffers[i] &&
+         (buffers[i]->set != set ||
+          buffers[i]->source != source ||
+          buffers[i]->destination != destination))
+    i = (i + 1) & (buffers_size - 1);
+  return &buffers[i];
+}
+
+static void
+buffers_grow (void)
+{
+  PathBuffer **old      = buffers;
+  int          old_size = buffers_size;
+  int          i;
+
+  buffers_size = buffers_size ? buffers_size * 2 : 256;
+  buffers      = babl_calloc (buffers_size, sizeof (PathBuffer *));
+  for (i = 0; i < old_size; i++)
+    if (old[i])
+      *buffer_slot (old[i]->set, old[i]->source, old[i]->destination) =
+        old[i];
+  if (old)
+    babl_free (old);
+}
+
+/* the buffer for source and destination, *make is set when its pixels
+ * are to be made */
+static PathBuffer *
+buffer_lookup (PixelSet    set,
+               const Babl *source,
+               const Babl *destination,
+               int        *make)
+{
+  PathBuffer **slot;
+
+  if ((buffers_count + 1) * 2 > buffers_size)
+    buffers_grow ();
+
+  slot  = buffer_slot (set, source, destination);
+  *make = 1;
+  if (*slot)
+    {
+      if (babl_format_is_palette (source) ||
+          (destination && babl_format_is_palette (destination)))
+        buffers_made++;
+      else
+        *make = 0;
+    }
+  else
+    {
+      *slot = babl_calloc (1, sizeof (PathBuffer));
+      (*slot)->set         = set;
+      (*slot)->source      = source;
+      (*slot)->destination = destination;
+      buffers_count++;
+      buffers_made++;
+    }
+  return *slot;
+}
+
+static int
+set_pixels (PixelSet set)
+{
+  return set == PATH_PIXELS ? babl_get_num_path_test_pixels ()
+                            : babl_get_num_conversion_test_pixels ();
+}
+
+static const void *
+test_buffer (PixelSet    set,
+             const Babl *format)
+{
+  const int   test_pixels = set_pixels (set);
+  int         make;
+  PathBuffer *buffer;
+
+  babl_mutex_lock (babl_format_mutex);
+  buffer = buffer_lookup (set, format, NULL, &make);
+  if (make)
+    {
+      if (!buffer->pixels)
+        buffer->pixels = babl_malloc ((long) test_pixels *
+                                      format->format.bytes_per_pixel);
+      babl_fish_reference_process (babl_fish_reference (rgba_double (), format),
+                                   (const char *) (set == PATH_PIXELS ?
+                                     babl_get_path_test_pixels () :
+                                     babl_get_conversion_test_pixels ()),
+                                   buffer->pixels, test_pixels);
+    }
+  babl_mutex_unlock (babl_format_mutex);
+  return buffer->pixels;
+}
+
+static const void *
+reference (PixelSet       set,
+           const Babl    *source,
+           const Babl    *destination,
+           const double **rgba,
+           long long     *nsecs)
+{
+  const int   test_pixels = set_pixels (set);
+  const void *source_pixels;
+  long long   ticks_start;
+  int         make;
+  PathBuffer *buffer;
+
+  babl_mutex_lock (babl_format_mutex);
+  source_pixels = test_buffer (set, source);
+  buffer        = buffer_lookup (set, source, destination, &make);
+  if (make)
+    {
+      if (!buffer->pixels)
+        {
+          buffer->pixels = babl_malloc ((long) test_pixels *
+                                        destination->format.bytes_per_pixel);
+          buffer->rgba   = babl_malloc ((long) test_pixels * 4 *
+                                        sizeof (double));
+        }
+
+      ticks_start = babl_nanoticks ();
+      babl_fish_reference_process (babl_fish_reference (source, destination),
+                                   source_pixels, buffer->pixels, test_pixels);
+      buffer->nsecs = babl_nanoticks () - ticks_start;
+
+      babl_fish_reference_process (babl_fish_reference (destination,
+                                                        rgba_double ()),
+                                   buffer->pixels, (char *) buffer->rgba,
+                                   test_pixels);
+    }
+  babl_mutex_unlock (babl_format_mutex);
+
+  if (rgba)
+    *rgba = buffer->rgba;
+  if (nsecs)
+    *nsecs = buffer->nsecs;
+  return buffer->pixels;
+}
+
+/* the path test pixels in format */
+const void *
+babl_path_test_buffer (const Babl *format)
+{
+  return test_buffer (PATH_PIXELS, format);
+}
+
+/* what the reference fish from source to destination makes of the path
+ * test pixels in source, and as RGBA double in rgba, nsecs is set to the
+ * time it took */
+const void *
+babl_path_reference (const Babl    *source,
+                     const Babl    *destination,
+                     const double **rgba,
+                     long long     *nsecs)
+{
+  return reference (PATH_PIXELS, source, destination, rgba, nsecs);
+}
+
+/* the conversion test pixels in format */
+const void *
+babl_conversion_test_buffer (const Babl *format)
+{
+  return test_buffer (CONVERSION_PIXELS, format);
+}
+
+/* what the reference fish from source to destination makes of the
+ * conversion test pixels in source, and as RGBA double in rgba */
+const void *
+babl_conversion_reference (const Babl    *source,
+                           const Babl    *destination,
+                           const double **rgba)
+{
+  return reference (CONVERSION_PIXELS, source, destination, rgba, NULL);
+}
+
+/* the number of buffers made, for tests */
+long
+babl_path_buffers_made (void)
+{
+  return buffers_made;
+}
+
+void
+babl_path_buffers_destroy (void)
+{
+  int i;
+
+  for (i = 0; i < buffers_size; i++)
+    if (buffers[i])
+      {
+        babl_free (buffers[i]->pixels);
+        if (buffers[i]->rgba)
+          babl_free (buffers[i]->rgba);
+        babl_free (buffers[i]);
+      }
+  if (buffers)
+    babl_free (buffers);
+  buffers       = NULL;
+  buffers_size  = 0;
+  buffers_count = 0;
+  buffers_made  = 0;
+}
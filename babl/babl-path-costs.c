@@ -0,0 +1,228 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* When BABL_PATH_COSTS names a file, paths are chosen by the sum of the
+ * costs of their conversions listed in it rather than by timing them,
+ * making the choice the same on every machine with the same conversions.
+ * A missing file is created by timing every registered conversion once.
+ * The file has a line per conversion, the nanoseconds per pixel it takes
+ * followed by its name without the directory of its extension.
+ */
+
+#include "config.h"
+#include <string.h>
+#include "babl-internal.h"
+#include "babl-ref-pixels.h"
+
+#define BABL_PATH_COSTS_RUNS  3
+
+typedef struct PathCost
+{
+  char   *name;
+  double  cost;  /* nanoseconds per pixel */
+} PathCost;
+
+typedef struct PathCosts
+{
+  PathCost *entries;
+  int       count;
+  int       size;
+} PathCosts;
+
+static const char *costs_file = NULL;
+static int         costs_mode = -1;
+static int         costs_loaded = 0;
+static PathCosts   costs = { NULL, 0, 0 };
+
+int
+babl_path_costs_static (void)
+{
+  if (costs_mode == -1)
+    {
+      const char *env = getenv ("BABL_PATH_COSTS");
+
+      costs_file = env;
+      costs_mode = env && env[0];
+    }
+  return costs_mode;
+}
+
+/* the name of a conversion, without the directory of its extension, which
+ * differs between installations */
+const char *
+babl_conversion_stable_name (const Babl *conversion)
+{
+  const char *name   = conversion->instance.name;
+  const char *end    = strstr (name, ": ");
+  const char *stable = name;
+  const char *p;
+
+  if (!end)
+    return name;
+  for (p = name; p < end; p++)
+    if (*p == '/' || *p == '\\')
+      stable = p + 1;
+  return stable;
+}
+
+static void
+costs_add (const char *name,
+           double      cost)
+{
+  if (costs.count == costs.size)
+    {
+      costs.size    = costs.size ? costs.size * 2 : 256;
+      costs.entries = babl_realloc (costs.entries,
+                                    sizeof (PathCost) * costs.size);
+    }
+  costs.entries[costs.count].name = babl_strdup (name);
+  costs.entries[costs.count].cost = cost;
+  costs.count++;
+}
+
+static int
+costs_compare (const void *a,
+               const void *b)
+{
+  return strcmp (((const PathCost *) a)->name, ((const PathCost *) b)->name);
+}
+
+static int
+measure_each (Babl *babl,
+              void *data)
+{
+  const Babl   *source          = babl->conversion.source;
+  const Babl   *destination     = babl->conversion.destination;
+  const int     test_pixels     = babl_get_num_path_test_pixels ();
+  const void   *src;
+  void         *dst;
+  long long     best = 0;
+  int           i;
+
+  if (babl->class_type != BABL_CONVERSION_LINEAR ||
+      source->class_type != BABL_FORMAT ||
+      destination->class_type != BABL_FORMAT)
+    return 0;
+
+  /* the test pixels path searches convert, made without counting them in
+   * the stats of a fish */
+  src = babl_path_test_buffer (source);
+  dst = babl_malloc ((long) test_pixels * destination->format.bytes_per_pixel);
+
+  for (i = 0; i < BABL_PATH_COSTS_RUNS; i++)
+    {
+      long long start = babl_nanoticks ();
+      long long nsecs;
+
+      babl_conversion_process (babl, src, dst, test_pixels);
+      nsecs = babl_nanoticks () - start;
+      if (i == 0 || nsecs < best)
+        best = nsecs;
+    }
+  costs_add (babl_conversion_stable_name (babl),
+             (double) best / test_pixels);
+
+  babl_free (dst);
+  return 0;
+}
+
+static void
+costs_measure (void)
+{
+  FILE       *file;
+  char       *temp_path;
+  int         i;
+
+  babl_conversion_class_for_each (measure_each, NULL);
+  qsort (costs.entries, costs.count, sizeof (PathCost), costs_compare);
+
+  /* processes starting while it is written read the whole table of
+   * another process, or measure their own, never a part of one */
+  file = babl_file_replace_open (costs_file, &temp_path);
+  if (!file)
+    {
+      babl_log ("unable to write path costs to %s", costs_file);
+      return;
+    }
+  fprintf (file, "# babl path costs, nanoseconds per pixel and conversion\n");
+  for (i = 0; i < costs.count; i++)
+    fprintf (file, "%.4f %s\n", costs.entries[i].cost, costs.entries[i].name);
+  if (!babl_file_replace_close (file, costs_file, temp_path))
+    babl_log ("unable to write path costs to %s", costs_file);
+}
+
+static void
+costs_load (void)
+{
+  FILE *file;
+  char  line[1024];
+
+  costs_loaded = 1;
+
+  file = fopen (costs_file, "r");
+  if (!file)
+    {
+      costs_measure ();
+      return;
+    }
+
+  while (fgets (line, sizeof (line), file))
+    {
+      char   *name;
+      char   *end;
+      double  cost;
+
+      if (line[0] == '#')
+        continue;
+      line[strcspn (line, "\r\n")] = '\0';
+      cost = strtod (line, &end);
+      /* path searches rely on costs only adding up */
+      if (end == line || *end != ' ' || !(cost >= 0.0))
+        continue;
+      name = end + 1;
+      costs_add (name, cost);
+    }
+  fclose (file);
+  qsort (costs.entries, costs.count, sizeof (PathCost), costs_compare);
+}
+
+/* the cost of a conversion in nanoseconds per pixel, conversions missing in
+ * the file, like ones registered while searching paths, are assumed to take
+ * a nanosecond for every eight bytes they read and write.
+ */
+double
+babl_path_costs_conversion (const Babl *conversion)
+{
+  PathCost  key;
+  PathCost *found;
+
+  if (!costs_loaded)
+    costs_load ();
+
+  key.name = (char *) babl_conversion_stable_name (conversion);
+  found = costs.count ? bsearch (&key, costs.entries, costs.count,
+                                 sizeof (PathCost), costs_compare) : NULL;
+  if (found)
+    return found->cost;
+
+  if (conversion->conversion.source->class_type == BABL_FORMAT &&
+      conversion->conversion.destination->class_type == BABL_FORMAT)
+    return (conversion->conversion.source->format.bytes_per_pixel +
+            conversion->conversion.destination->format.bytes_per_pixel) / 8.0;
+  return 1.0;
+}
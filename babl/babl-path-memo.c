@@ -0,0 +1,245 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* The paths found by path searches are remembered by the format they start
+ * from, the format they end at and the tolerance they were found for,
+ * along with the paths on from each of their intermediate formats. A later
+ * search reaching one of these formats on its way to the same destination
+ * measures the remembered path first, making it the cost to beat. It gives
+ * up on the other paths through there when the conversion errors ruled out
+ * all paths on from there, or, with timed costs, when a search from there
+ * found the remembered path. Registering a conversion forgets all paths, it
+ * might make better ones through any format.
+ *
+ * The memo is only used by path searches, which hold babl_format_mutex.
+ * Setting BABL_PATH_MEMO to 0 disables it, it is disabled by default with
+ * static path costs.
+ */
+
+#include "config.h"
+#include "babl-internal.h"
+
+typedef struct PathMemoEntry
+{
+  const Babl *source;
+  const Babl *destination;
+  double      tolerance;
+  int         searched;  /* found by a search from source, not a part of
+                            a path found from another format */
+  BablList   *path;
+} PathMemoEntry;
+
+static int             memo_enabled     = -1;
+static PathMemoEntry **memo             = NULL;
+static int             memo_size        = 0;  /* a power of two */
+static int             memo_count       = 0;
+static int             memo_conversions = 0;  /* registered when validated */
+static long            memo_hits        = 0;
+
+static int
+path_memo_enabled (void)
+{
+  if (memo_enabled == -1)
+    {
+      const char *env = getenv ("BABL_PATH_MEMO");
+
+      /* paths chosen by static costs are not to depend on the searches
+       * made before, unless asked for */
+      memo_enabled = env ? atoi (env) != 0 : !babl_path_costs_static ();
+    }
+  return memo_enabled;
+}
+
+static unsigned int
+memo_hash (const Babl *source,
+           const Babl *destination)
+{
+  size_t key = (size_t) source * 31 + (size_t) destination;
+
+  key ^= key >> 15;
+  key *= 0x2c1b3c6d;
+  key ^= key >> 12;
+  return (unsigned int) key;
+}
+
+/* the slot of the entry for source, destination and tolerance, or the empty
+ * slot it would take */
+static PathMemoEntry **
+memo_slot (const Babl *source,
+           const Babl *destination,
+           double      tolerance)
+{
+  unsigned int i = memo_hash (source, destination) & (memo_size - 1);
+
+  while (memo[i] &&
+         (memo[i]->source != source ||
+          memo[i]->destination != destination ||
+          memo[i]->tolerance != tolerance))
+    i = (i + 1) & (memo_size - 1);
+  return &memo[i];
+}
+
+static void
+memo_clear (void)
+{
+  int i;
+
+  for (i = 0; i < memo_size; i++)
+    if (memo[i])
+      {
+        babl_free (memo[i]->path);
+        babl_free (memo[i]);
+        memo[i] = NULL;
+      }
+  memo_count = 0;
+}
+
+/* rehashes the entries into a table of size */
+static void
+memo_rehash (int size)
+{
+  PathMemoEntry **old      = memo;
+  int             old_size = memo_size;
+  int             i;
+
+  memo_size = size;
+  memo      = babl_calloc (memo_size, sizeof (PathMemoEntry *));
+  for (i = 0; i < old_size; i++)
+    if (old[i])
+      *memo_slot (old[i]->source, old[i]->destination, old[i]->tolerance) =
+        old[i];
+  if (old)
+    babl_free (old);
+}
+
+/* forgets all paths when conversions were registered since the last call */
+static void
+memo_validate (void)
+{
+  int count = babl_db_count (babl_conversion_db ());
+
+  if (memo_conversions != count && memo_count)
+    memo_clear ();
+  memo_conversions = count;
+}
+
+static void
+memo_insert (const Babl *source,
+             const Babl *destination,
+             double      tolerance,
+             int         searched,
+             BablList   *path,
+             int         first)
+{
+  PathMemoEntry **slot;
+  PathMemoEntry  *entry;
+  int             i;
+
+  if ((memo_count + 1) * 2 > memo_size)
+    memo_rehash (memo_size ? memo_size * 2 : 256);
+
+  slot  = memo_slot (source, destination, tolerance);
+  entry = *slot;
+  if (entry)
+    {
+      /* what a search from source found is not replaced by a part of
+       * another path */
+      if (entry->searched && !searched)
+        return;
+      entry->path->count = 0;
+    }
+  else
+    {
+      entry = babl_calloc (1, sizeof (PathMemoEntry));
+      entry->source      = source;
+      entry->destination = destination;
+      entry->tolerance   = tolerance;
+      entry->path        = babl_list_init_with_size (babl_list_size (path));
+      *slot = entry;
+      memo_count++;
+    }
+
+  entry->searched = searched;
+  for (i = first; i < babl_list_size (path); i++)
+    babl_list_insert_last (entry->path, path->items[i]);
+}
+
+void
+babl_path_memo_insert (const Babl *source,
+                       const Babl *destination,
+                       double      tolerance,
+                       BablList   *path)
+{
+  int i;
+
+  if (!path_memo_enabled ())
+    return;
+  memo_validate ();
+
+  memo_insert (source, destination, tolerance, 1, path, 0);
+  /* the rest of the path is taken to be the best way on from each of
+   * its intermediate formats */
+  for (i = 1; i < babl_list_size (path); i++)
+    memo_insert (BABL (path->items[i])->conversion.source, destination,
+                 tolerance, 0, path, i);
+}
+
+/* the best known path from source to destination, empty when no path
+ * was worth measuring, or NULL when not known; searched is set when it was
+ * found by a search from source, not as a part of a path from another
+ * format */
+BablList *
+babl_path_memo_lookup (const Babl *source,
+                       const Babl *destination,
+                       double      tolerance,
+                       int        *searched)
+{
+  PathMemoEntry *entry;
+
+  if (!path_memo_enabled () || !memo_count)
+    return NULL;
+  memo_validate ();
+  if (!memo_count)
+    return NULL;
+
+  entry = *memo_slot (source, destination, tolerance);
+  if (!entry)
+    return NULL;
+  memo_hits++;
+  if (searched)
+    *searched = entry->searched;
+  return entry->path;
+}
+
+long
+babl_path_memo_hits (void)
+{
+  return memo_hits;
+}
+
+void
+babl_path_memo_destroy (void)
+{
+  memo_clear ();
+  if (memo)
+    babl_free (memo);
+  memo             = NULL;
+  memo_size        = 0;
+  memo_conversions = 0;
+  memo_hits        = 0;
+}
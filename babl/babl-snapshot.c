@@ -0,0 +1,422 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* When BABL_SNAPSHOT names a file, the errors and costs measured for
+ * conversions and the losses measured for formats are restored from it
+ * by name instead of being measured again. Measurements made for things
+ * missing in the file are added to it by babl_exit (). The file is
+ * ignored when written by another version of babl, or on a machine with
+ * other cpu features.
+ *
+ * Only what every process using the same extensions has is kept: the
+ * conversions of palettes and the conversion tables made for the pairs of
+ * formats a process uses are left out, and when the file is written the
+ * entries of the extensions this process loaded are kept only for the
+ * conversions they still register.
+ *
+ * The file has a header line followed by a line per measurement,
+ *
+ *   babl-snapshot <file version> <babl version> <cpu features>
+ *   conversion <error> <cost> <name without the directory of its extension>
+ *   format <loss> <name>
+ *
+ * with errors and losses written in hexadecimal, restoring them exactly.
+ */
+
+#include "config.h"
+#include <string.h>
+#include "babl-internal.h"
+
+#define BABL_SNAPSHOT_VERSION  2
+
+typedef struct SnapshotEntry
+{
+  char   *name;
+  double  value;  /* the error of a conversion, or the loss of a format */
+  long    cost;
+} SnapshotEntry;
+
+typedef struct SnapshotTable
+{
+  SnapshotEntry *entries;
+  int            count;
+  int            size;
+} SnapshotTable;
+
+static const char    *snapshot_file    = NULL;
+static int            snapshot_changed = 0;
+static SnapshotTable  conversions      = { NULL, 0, 0 };
+static SnapshotTable  formats          = { NULL, 0, 0 };
+
+static void
+table_add (SnapshotTable *table,
+           const char    *name,
+           double         value,
+           long           cost)
+{
+  if (table->count == table->size)
+    {
+      table->size    = table->size ? table->size * 2 : 256;
+      table->entries = babl_realloc (table->entries,
+                                     sizeof (SnapshotEntry) * table->size);
+    }
+  table->entries[table->count].name  = babl_strdup (name);
+  table->entries[table->count].value = value;
+  table->entries[table->count].cost  = cost;
+  table->count++;
+}
+
+static int
+entry_compare (const void *a,
+               const void *b)
+{
+  return strcmp (((const SnapshotEntry *) a)->name,
+                 ((const SnapshotEntry *) b)->name);
+}
+
+static void
+table_sort (SnapshotTable *table)
+{
+  if (table->count)
+    qsort (table->entries, table->count, sizeof (SnapshotEntry),
+           entry_compare);
+}
+
+static SnapshotEntry *
+table_find (SnapshotTable *table,
+            const char    *name)
+{
+  SnapshotEntry key;
+
+  if (!table->count)
+    return NULL;
+  key.name = (char *) name;
+  return bsearch (&key, table->entries, table->count,
+                  sizeof (SnapshotEntry), entry_compare);
+}
+
+static void
+table_destroy (SnapshotTable *table)
+{
+  int i;
+
+  for (i = 0; i < table->count; i++)
+    babl_free (table->entries[i].name);
+  if (table->entries)
+    babl_free (table->entries);
+  table->entries = NULL;
+  table->count   = 0;
+  table->size    = 0;
+}
+
+static void
+snapshot_header (char *header,
+                 int   size)
+{
+  snprintf (header, size, "babl-snapshot %i %i.%i.%i %x",
+            BABL_SNAPSHOT_VERSION,
+            BABL_MAJOR_VERSION, BABL_MINOR_VERSION, BABL_MICRO_VERSION,
+            (unsigned int) babl_cpu_accel_get_support ());
+}
+
+void
+babl_snapshot_load (void)
+{
+  const char *env = getenv ("BABL_SNAPSHOT");
+  FILE       *file;
+  char        header[128];
+  char        line[1024];
+
+  snapshot_file    = env && env[0] ? env : NULL;
+  snapshot_changed = 0;
+  if (!snapshot_file)
+    return;
+
+  file = fopen (snapshot_file, "r");
+  if (!file)
+    return;
+
+  snapshot_header (header, sizeof (header));
+  if (!fgets (line, sizeof (line), file))
+    line[0] = '\0';
+  line[strcspn (line, "\r\n")] = '\0';
+  if (strcmp (line, header))
+    {
+      fclose (file);
+      return;
+    }
+
+  while (fgets (line, sizeof (line), file))
+    {
+      char   *p = line;
+      char   *end;
+      double  value;
+      long    cost = 0;
+      int     is_conversion;
+
+      line[strcspn (line, "\r\n")] = '\0';
+      if (!strncmp (p, "conversion ", 11))
+        {
+          is_conversion = 1;
+          p += 11;
+        }
+      else if (!strncmp (p, "format ", 7))
+        {
+          is_conversion = 0;
+          p += 7;
+        }
+      else
+        continue;
+
+      value = strtod (p, &end);
+      if (end == p || *end != ' ')
+        continue;
+      p = end + 1;
+      if (is_conversion)
+        {
+          cost = strtol (p, &end, 10);
+          if (end == p || *end != ' ')
+            continue;
+          p = end + 1;
+        }
+      table_add (is_conversion ? &conversions : &formats, p, value, cost);
+    }
+  fclose (file);
+
+  table_sort (&conversions);
+  table_sort (&formats);
+}
+
+static int
+is_palette (const Babl *babl)
+{
+  if (babl->class_type == BABL_MODEL)
+    return babl->model.palette;
+  return babl_format_is_palette (babl);
+}
+
+/* palettes are made with names counted per process, or given by the
+ * application for its own colors */
+static int
+is_snapshot_conversion (const Babl *conversion)
+{
+  return !is_palette (conversion->conversion.source) &&
+         !is_palette (conversion->conversion.destination) &&
+         !babl_conversion_is_table (conversion);
+}
+
+/* sets the error and cost of conversion from the snapshot, returns 0 when
+ * they are not in it and have to be measured */
+int
+babl_snapshot_conversion (BablConversion *conversion)
+{
+  SnapshotEntry *entry;
+
+  if (!snapshot_file || !is_snapshot_conversion (BABL (conversion)))
+    return 0;
+
+  entry = table_find (&conversions, babl_conversion_stable_name (BABL (conversion)));
+  if (!entry)
+    {
+      snapshot_changed = 1;
+      return 0;
+    }
+  conversion->error = entry->value;
+  conversion->cost  = entry->cost;
+  return 1;
+}
+
+/* sets the loss of format from the snapshot, returns 0 when it is not in
+ * it and has to be measured */
+int
+babl_snapshot_format (Babl *format)
+{
+  SnapshotEntry *entry;
+
+  if (!snapshot_file || babl_format_is_palette (format))
+    return 0;
+
+  entry = table_find (&formats, format->instance.name);
+  if (!entry)
+    {
+      snapshot_changed = 1;
+      return 0;
+    }
+  format->format.loss = entry->value;
+  return 1;
+}
+
+static int
+collect_conversion (Babl *babl,
+                    void *data)
+{
+  if (babl->conversion.error != -1.0 && is_snapshot_conversion (babl))
+    table_add (data, babl_conversion_stable_name (babl),
+               babl->conversion.error, babl->conversion.cost);
+  return 0;
+}
+
+static int
+collect_present (Babl *babl,
+                 void *data)
+{
+  if (is_snapshot_conversion (babl))
+    table_add (data, babl_conversion_stable_name (babl), 0.0, 0);
+  return 0;
+}
+
+static int
+collect_format (Babl *babl,
+                void *data)
+{
+  if (babl->format.loss != -1.0 && !babl_format_is_palette (babl))
+    table_add (data, babl->instance.name, babl->format.loss, 0);
+  return 0;
+}
+
+/* the names of the extensions loaded, without their directories like the
+ * stable names of their conversions */
+static int
+collect_extension (Babl *babl,
+                   void *data)
+{
+  const char *name = babl->instance.name;
+  const char *p;
+
+  for (p = babl->instance.name; *p; p++)
+    if (*p == '/' || *p == '\\')
+      name = p + 1;
+  table_add (data, name, 0.0, 0);
+  return 0;
+}
+
+/* whether the stable name of a conversion, "<extension> <n>: <name>", is
+ * one of an extension in loaded */
+static int
+is_loaded (SnapshotTable *loaded,
+           const char    *name)
+{
+  const char *end = strstr (name, ": ");
+  char        extension[512];
+  int         length;
+
+  if (!end)
+    return 1;
+  while (end > name && end[-1] != ' ')
+    end--;
+  length = end - name - 1;
+  if (length <= 0 || length >= (int) sizeof (extension))
+    return 1;
+  memcpy (extension, name, length);
+  extension[length] = '\0';
+  return table_find (loaded, extension) != NULL;
+}
+
+/* adds the entries of from missing in to, keeping what was restored for
+ * the extensions not loaded by this process, and of the loaded ones what
+ * is in present; the rest are conversions an extension no longer has */
+static void
+table_merge (SnapshotTable *to,
+             SnapshotTable *from,
+             SnapshotTable *loaded,
+             SnapshotTable *present)
+{
+  int count = to->count;
+  int i;
+
+  table_sort (to);
+  for (i = 0; i < from->count; i++)
+    {
+      SnapshotEntry key;
+
+      key.name = from->entries[i].name;
+      if (loaded && is_loaded (loaded, key.name) &&
+          !table_find (present, key.name))
+        continue;
+      if (!count || !bsearch (&key, to->entries, count,
+                              sizeof (SnapshotEntry), entry_compare))
+        table_add (to, from->entries[i].name,
+                   from->entries[i].value, from->entries[i].cost);
+    }
+  table_sort (to);
+}
+
+/* writes the snapshot when something was measured that was not in it */
+void
+babl_snapshot_save (void)
+{
+  SnapshotTable  measured_conversions = { NULL, 0, 0 };
+  SnapshotTable  measured_formats     = { NULL, 0, 0 };
+  SnapshotTable  loaded               = { NULL, 0, 0 };
+  SnapshotTable  present              = { NULL, 0, 0 };
+  FILE          *file;
+  char          *temp_path;
+  char           header[128];
+  int            i;
+
+  if (!snapshot_file || !snapshot_changed)
+    return;
+
+  babl_db_each (babl_conversion_db (), collect_conversion, &measured_conversions);
+  babl_db_each (babl_format_db (), collect_format, &measured_formats);
+  babl_db_each (babl_extension_db (), collect_extension, &loaded);
+  babl_db_each (babl_conversion_db (), collect_present, &present);
+  table_sort (&loaded);
+  table_sort (&present);
+  table_merge (&measured_conversions, &conversions, &loaded, &present);
+  table_merge (&measured_formats, &formats, NULL, NULL);
+
+  /* processes exiting at once each put a whole snapshot in place, and
+   * processes starting meanwhile read one of them */
+  file = babl_file_replace_open (snapshot_file, &temp_path);
+  if (!file)
+    {
+      babl_log ("unable to write snapshot to %s", snapshot_file);
+    }
+  else
+    {
+      snapshot_header (header, sizeof (header));
+      fprintf (file, "%s\n", header);
+      for (i = 0; i < measured_conversions.count; i++)
+        fprintf (file, "conversion %a %li %s\n",
+                 measured_conversions.entries[i].value,
+                 measured_conversions.entries[i].cost,
+                 measured_conversions.entries[i].name);
+      for (i = 0; i < measured_formats.count; i++)
+        fprintf (file, "format %a %s\n",
+                 measured_formats.entries[i].value,
+                 measured_formats.entries[i].name);
+      if (babl_file_replace_close (file, snapshot_file, temp_path))
+        snapshot_changed = 0;
+      else
+        babl_log ("unable to write snapshot to %s", snapshot_file);
+    }
+
+  table_destroy (&measured_conversions);
+  table_destroy (&measured_formats);
+  table_destroy (&loaded);
+  table_destroy (&present);
+}
+
+void
+babl_snapshot_destroy (void)
+{
+  table_destroy (&conversions);
+  table_destroy (&formats);
+  snapshot_file = NULL;
+}
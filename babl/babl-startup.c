@@ -0,0 +1,198 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* When BABL_STARTUP_PROFILE is set, the phases of babl_init () and the
+ * loading of each extension record the time they take and what they
+ * register. Phases can nest, like an extension loaded on demand by the
+ * init () of another, each phase only counts what is not done by the
+ * phases within it.
+ *
+ * Extensions can be loaded on demand by any thread, the phases are only
+ * changed and copied while holding a mutex.
+ */
+
+#include "config.h"
+#include "babl-internal.h"
+
+#define BABL_STARTUP_MAX_DEPTH  16
+
+typedef struct StartupFrame
+{
+  int       phase;       /* index in phases */
+  long long start;       /* nanoticks */
+  int       start_count[5];
+  long long inner_nsecs; /* of the phases within */
+  int       inner_count[5];
+} StartupFrame;
+
+static int               profile_enabled = -1;
+static BablStartupPhase *phases          = NULL;
+static int               phase_count     = 0;
+static int               phase_size      = 0;
+static StartupFrame      stack[BABL_STARTUP_MAX_DEPTH];
+static int               depth           = 0;
+static BablMutex        *mutex           = NULL;
+
+static int
+startup_profiling (void)
+{
+  if (profile_enabled == -1)
+    {
+      const char *env = getenv ("BABL_STARTUP_PROFILE");
+
+      profile_enabled = env && env[0] && atoi (env) != 0;
+    }
+  return profile_enabled;
+}
+
+static void
+registered (int count[5])
+{
+  count[0] = babl_db_count (babl_type_db ());
+  count[1] = babl_db_count (babl_component_db ());
+  count[2] = babl_db_count (babl_model_db ());
+  count[3] = babl_db_count (babl_format_db ());
+  count[4] = babl_db_count (babl_conversion_db ());
+}
+
+void
+babl_startup_profile_init (void)
+{
+  mutex = babl_mutex_new ();
+}
+
+void
+babl_startup_phase_begin (const char *name)
+{
+  StartupFrame *frame;
+
+  if (!startup_profiling () || !mutex)
+    return;
+  babl_mutex_lock (mutex);
+  if (depth >= BABL_STARTUP_MAX_DEPTH)
+    {
+      depth++; /* not recorded, but kept balanced */
+      babl_mutex_unlock (mutex);
+      return;
+    }
+
+  if (phase_count == phase_size)
+    {
+      phase_size = phase_size ? phase_size * 2 : 32;
+      phases     = babl_realloc (phases, sizeof (BablStartupPhase) * phase_size);
+    }
+  memset (&phases[phase_count], 0, sizeof (BablStartupPhase));
+  phases[phase_count].name  = babl_strdup (name);
+  phases[phase_count].depth = depth;
+
+  frame = &stack[depth++];
+  memset (frame, 0, sizeof (StartupFrame));
+  frame->phase = phase_count++;
+  registered (frame->start_count);
+  frame->start = babl_nanoticks ();
+  babl_mutex_unlock (mutex);
+}
+
+void
+babl_startup_phase_end (void)
+{
+  long long         end;
+  int               count[5];
+  StartupFrame     *frame;
+  BablStartupPhase *phase;
+  long long         nsecs;
+  int               i;
+
+  if (!startup_profiling () || !mutex)
+    return;
+  end = babl_nanoticks ();
+  babl_mutex_lock (mutex);
+  if (depth == 0 || depth-- > BABL_STARTUP_MAX_DEPTH)
+    {
+      babl_mutex_unlock (mutex);
+      return;
+    }
+
+  frame = &stack[depth];
+  registered (count);
+  for (i = 0; i < 5; i++)
+    count[i] -= frame->start_count[i];
+  nsecs = end - frame->start;
+
+  phase = &phases[frame->phase];
+  phase->nsecs       = nsecs - frame->inner_nsecs;
+  phase->types       = count[0] - frame->inner_count[0];
+  phase->components  = count[1] - frame->inner_count[1];
+  phase->models      = count[2] - frame->inner_count[2];
+  phase->formats     = count[3] - frame->inner_count[3];
+  phase->conversions = count[4] - frame->inner_count[4];
+
+  if (depth > 0)
+    {
+      StartupFrame *outer = &stack[depth - 1];
+
+      outer->inner_nsecs += nsecs;
+      for (i = 0; i < 5; i++)
+        outer->inner_count[i] += count[i];
+    }
+  babl_mutex_unlock (mutex);
+}
+
+void
+babl_startup_profile_foreach (BablStartupPhaseFunc  func,
+                              void                 *user_data)
+{
+  BablStartupPhase *copy;
+  int               count;
+  int               i;
+
+  if (!mutex)
+    return;
+
+  /* the callback gets a copy, phases can be added while it runs */
+  babl_mutex_lock (mutex);
+  count = phase_count;
+  copy  = count ? babl_malloc (sizeof (BablStartupPhase) * count) : NULL;
+  if (count)
+    memcpy (copy, phases, sizeof (BablStartupPhase) * count);
+  babl_mutex_unlock (mutex);
+
+  for (i = 0; i < count; i++)
+    if (func (&copy[i], user_data))
+      break;
+  if (copy)
+    babl_free (copy);
+}
+
+void
+babl_startup_profile_destroy (void)
+{
+  int i;
+
+  for (i = 0; i < phase_count; i++)
+    babl_free ((char *) phases[i].name);
+  if (phases)
+    babl_free (phases);
+  phases      = NULL;
+  phase_count = 0;
+  phase_size  = 0;
+  depth       = 0;
+  if (mutex)
+    babl_mutex_destroy (mutex);
+  mutex       = NULL;
+}
@@ -0,0 +1,33 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "babl-internal.h"
+
+BablTraceFunc  babl_trace_func = NULL;
+void          *babl_trace_data = NULL;
+
+void
+babl_set_trace_func (BablTraceFunc  func,
+                     void          *user_data)
+{
+  /* the data is set first, such that a thread seeing the new function
+   * doesn't call it with the data of no function at all */
+  babl_trace_data = user_data;
+  babl_trace_func = func;
+}
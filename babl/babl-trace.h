@@ -0,0 +1,47 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BABL_TRACE_H
+#define _BABL_TRACE_H
+
+/* Trace points are emitted both as SystemTap/USDT static probes, when
+ * <sys/sdt.h> was found at configure time, and to the function set with
+ * babl_set_trace_func (). Without a function set, the cost of a trace
+ * point is a load and a branch.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define BABL_TRACE_PROBE(probe, source, destination, count) \
+  STAP_PROBE3 (babl, probe, source, destination, count)
+#else
+#define BABL_TRACE_PROBE(probe, source, destination, count)
+#endif
+
+extern BablTraceFunc  babl_trace_func;
+extern void          *babl_trace_data;
+
+#define BABL_TRACE(event, probe, source, destination, count)            \
+  do {                                                                  \
+    BABL_TRACE_PROBE (probe, source, destination, count);               \
+    if (babl_trace_func)                                                \
+      babl_trace_func (BABL_TRACE_##event, (source), (destination),     \
+                       (count), babl_trace_data);                       \
+  } while (0)
+
+#endif
@@ -20,11 +20,16 @@
 #include <math.h>
 #include "babl-internal.h"
 
+#include <string.h>
+
 #ifdef __WIN32__
 #include <windows.h>
+#include <process.h>
+#define getpid _getpid
 #else
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 #endif
 
 #ifdef __WIN32__
@@ -54,6 +59,23 @@ babl_ticks (void)
   QueryPerformanceCounter(&end_time);
   return (end_time.QuadPart - start_time.QuadPart) * (1000000.0 / timer_freq.QuadPart);
 }
+
+/* the counter is split in seconds and the remainder before scaling, the
+ * nanoseconds of the whole count overflow 64 bits within hours at
+ * the frequencies of some counters */
+int64_t
+babl_nanoticks (void)
+{
+  LARGE_INTEGER end_time;
+  int64_t       ticks;
+
+  init_ticks ();
+
+  QueryPerformanceCounter(&end_time);
+  ticks = end_time.QuadPart - start_time.QuadPart;
+  return ticks / timer_freq.QuadPart * INT64_C (1000000000) +
+         ticks % timer_freq.QuadPart * INT64_C (1000000000) / timer_freq.QuadPart;
+}
 #else
 static struct timeval start_time;
 
@@ -78,6 +100,21 @@ babl_ticks (void)
   gettimeofday (&measure_time, NULL);
   return usecs (measure_time) - usecs (start_time);
 }
+
+/* a monotonic clock with finer resolution than babl_ticks, for timing
+ * single processings; 64 bits wide, where long is 32 bits it would
+ * overflow within seconds */
+int64_t
+babl_nanoticks (void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec measure_time;
+  clock_gettime (CLOCK_MONOTONIC, &measure_time);
+  return (int64_t) measure_time.tv_sec * 1000000000 + measure_time.tv_nsec;
+#else
+  return (int64_t) babl_ticks () * 1000;
+#endif
+}
 #endif
 
 long
@@ -106,3 +143,49 @@ babl_rel_avg_error (const double *imgA,
   return error;
 }
 
+
+/* opens a file next to path for writing what is to replace path, the
+ * name it gets is set in temp_path, readers of path never see it
+ * partially written and processes writing it at once do not mix their
+ * contents. Returns NULL when it cannot be opened.
+ */
+FILE *
+babl_file_replace_open (const char  *path,
+                        char       **temp_path)
+{
+  static int  count = 0;
+  FILE       *file;
+
+  *temp_path = babl_malloc (strlen (path) + 64);
+  sprintf (*temp_path, "%s.%i-%i.tmp", path, (int) getpid (), count++);
+  file = fopen (*temp_path, "w");
+  if (!file)
+    {
+      babl_free (*temp_path);
+      *temp_path = NULL;
+    }
+  return file;
+}
+
+/* closes file opened with babl_file_replace_open and puts it in place of
+ * path, returns 0 when it could not be written */
+int
+babl_file_replace_close (FILE       *file,
+                         const char *path,
+                         char       *temp_path)
+{
+  int written = !ferror (file);
+
+  written = !fclose (file) && written;
+#ifdef __WIN32__
+  /* rename does not replace existing files here */
+  if (written)
+    remove (path);
+#endif
+  if (written)
+    written = !rename (temp_path, path);
+  if (!written)
+    remove (temp_path);
+  babl_free (temp_path);
+  return written;
+}
@@ -19,9 +19,14 @@
 #ifndef _BABL_UTIL_H
 #define _BABL_UTIL_H
 
+#include <stdint.h>
+
 long
 babl_ticks     (void);
 
+int64_t
+babl_nanoticks (void);
+
 long
 babl_process_cost (long ticks_start,
                    long ticks_end);
@@ -30,4 +35,13 @@ double
 babl_rel_avg_error (const double *imgA,
                     const double *imgB,
                     long          samples);
+
+FILE *
+babl_file_replace_open  (const char   *path,
+                         char        **temp_path);
+
+int
+babl_file_replace_close (FILE         *file,
+                         const char   *path,
+                         char         *temp_path);
 #endif
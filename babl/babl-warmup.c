@@ -0,0 +1,192 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* babl_warmup () measures the error and cost of every conversion between
+ * formats before path searches ask for them, spreading the measurements
+ * over threads, each measuring every threads'th conversion. The reference
+ * fishes used by the measurements, and the
+ * shared buffers of what they make of the test pixels, are created before
+ * the threads start. Making a buffer holds babl_format_mutex, the threads
+ * are left to only process pixels without it.
+ */
+
+#include "config.h"
+#include "babl-internal.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define BABL_WARMUP_MAX_THREADS  64
+
+typedef struct Warmup
+{
+  BablList  *conversions;
+  int        threads;
+  int        measuring;  /* threads which measured conversions */
+  BablMutex *mutex;
+} Warmup;
+
+typedef struct WarmupThread
+{
+  Warmup *warmup;
+  int     first;  /* the first conversion measured by the thread */
+} WarmupThread;
+
+/* of the last babl_warmup (), for tests */
+static int  warmup_measuring = 0;
+static long warmup_buffers   = 0;
+
+static int
+collect_conversion (Babl *babl,
+                    void *data)
+{
+  Warmup     *warmup      = data;
+  const Babl *source      = babl->conversion.source;
+  const Babl *destination = babl->conversion.destination;
+
+  if (source->class_type != BABL_FORMAT ||
+      destination->class_type != BABL_FORMAT ||
+      source == destination ||
+      babl->conversion.error != -1.0)
+    return 0;
+
+  /* restored conversions need not be measured */
+  if (babl_snapshot_conversion (&babl->conversion))
+    return 0;
+
+  babl_list_insert_last (warmup->conversions, babl);
+  return 0;
+}
+
+static void *
+warmup_thread (void *data)
+{
+  WarmupThread *thread = data;
+  Warmup       *warmup = thread->warmup;
+  int           i;
+
+  for (i = thread->first; i < babl_list_size (warmup->conversions);
+       i += warmup->threads)
+    babl_conversion_error ((BablConversion *) warmup->conversions->items[i]);
+
+  if (thread->first < babl_list_size (warmup->conversions))
+    {
+      babl_mutex_lock (warmup->mutex);
+      warmup->measuring++;
+      babl_mutex_unlock (warmup->mutex);
+    }
+  return NULL;
+}
+
+int
+babl_warmup (int threads)
+{
+  const Babl   *fmt_rgba_double = babl_format_new (babl_model ("RGBA"),
+                                                   babl_type ("double"),
+                                                   babl_component ("R"),
+                                                   babl_component ("G"),
+                                                   babl_component ("B"),
+                                                   babl_component ("A"),
+                                                   NULL);
+  Warmup        warmup;
+  WarmupThread  thread[BABL_WARMUP_MAX_THREADS];
+  long          buffers;
+  int           count;
+  int           i;
+
+  warmup.conversions = babl_list_init_with_size (512);
+  warmup.measuring   = 0;
+  warmup.mutex       = babl_mutex_new ();
+
+  /* loads the extensions not loaded yet, they might be needed later */
+  babl_conversion_class_for_each (collect_conversion, &warmup);
+  count = babl_list_size (warmup.conversions);
+
+  for (i = 0; i < count; i++)
+    {
+      Babl       *conversion  = warmup.conversions->items[i];
+      const Babl *source      = conversion->conversion.source;
+      const Babl *destination = conversion->conversion.destination;
+
+      babl_fish_reference (fmt_rgba_double, source);
+      babl_fish_reference (source, destination);
+      babl_fish_reference (destination, fmt_rgba_double);
+      babl_fish_simple (&conversion->conversion);
+
+      /* those of palettes are made again by every measurement */
+      if (!babl_format_is_palette (source) &&
+          !babl_format_is_palette (destination))
+        babl_conversion_reference (source, destination, NULL);
+    }
+
+  if (threads > BABL_WARMUP_MAX_THREADS)
+    threads = BABL_WARMUP_MAX_THREADS;
+  if (threads > count)
+    threads = count;
+#ifdef _WIN32
+  threads = 1;
+#endif
+  if (threads < 1)
+    threads = 1;
+  warmup.threads = threads;
+  for (i = 0; i < threads; i++)
+    {
+      thread[i].warmup = &warmup;
+      thread[i].first  = i;
+    }
+
+  buffers = babl_path_buffers_made ();
+#ifndef _WIN32
+  if (threads > 1)
+    {
+      pthread_t pthread[BABL_WARMUP_MAX_THREADS];
+      int       started[BABL_WARMUP_MAX_THREADS];
+
+      /* the calling thread is the first of them, and measures for those
+       * failing to start */
+      for (i = 1; i < threads; i++)
+        started[i] = !pthread_create (&pthread[i], NULL, warmup_thread,
+                                      &thread[i]);
+      warmup_thread (&thread[0]);
+      for (i = 1; i < threads; i++)
+        if (started[i])
+          pthread_join (pthread[i], NULL);
+        else
+          warmup_thread (&thread[i]);
+    }
+  else
+#endif
+    warmup_thread (&thread[0]);
+  warmup_measuring = warmup.measuring;
+  warmup_buffers   = babl_path_buffers_made () - buffers;
+
+  babl_mutex_destroy (warmup.mutex);
+  babl_free (warmup.conversions);
+  return count;
+}
+
+/* the threads which measured conversions in the last babl_warmup (), and
+ * the buffers they made, for tests */
+void
+babl_warmup_stats (int  *measuring,
+                   long *buffers)
+{
+  *measuring = warmup_measuring;
+  *buffers   = warmup_buffers;
+}
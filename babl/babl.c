@@ -134,6 +134,8 @@ babl_init (void)
       char * dir_list;
 
       babl_internal_init ();
+      babl_startup_profile_init ();
+      babl_startup_phase_begin ("classes");
       babl_sampling_class_init ();
       babl_type_db ();
       babl_component_db ();
@@ -142,14 +144,35 @@ babl_init (void)
       babl_conversion_db ();
       babl_extension_db ();
       babl_fish_db ();
+      babl_startup_phase_end ();
+
+      babl_startup_phase_begin ("core");
       babl_core_init ();
+      babl_startup_phase_end ();
+      babl_startup_phase_begin ("sanity");
       babl_sanity ();
+      babl_startup_phase_end ();
+      babl_startup_phase_begin ("base");
       babl_extension_base ();
+      babl_startup_phase_end ();
+      babl_startup_phase_begin ("sanity");
       babl_sanity ();
+      babl_startup_phase_end ();
 
+      /* the time of the extensions phase itself goes to finding them and
+       * reading their manifests */
+      babl_startup_phase_begin ("extensions");
+#ifdef BABL_BUILTIN_EXTENSIONS
+      babl_extension_load_builtin ();
+#endif
       dir_list = babl_dir_list ();
       babl_extension_load_dir_list (dir_list);
       babl_free (dir_list);
+      babl_startup_phase_end ();
+
+      babl_startup_phase_begin ("snapshot");
+      babl_snapshot_load ();
+      babl_startup_phase_end ();
     }
 }
 
@@ -169,7 +192,17 @@ babl_exit (void)
               fclose (logfile);
             }
         }
-
+      if (getenv ("BABL_ADVISOR"))
+        babl_fish_advise (stderr);
+
+      babl_fish_profile_save ();
+      babl_snapshot_save ();
+      babl_snapshot_destroy ();
+      babl_startup_profile_destroy ();
+      babl_fish_path_deinit ();
+      babl_path_memo_destroy ();
+      babl_path_buffers_destroy ();
+      babl_conversion_table_deinit ();
       babl_extension_deinit ();
       babl_free (babl_extension_db ());;
       babl_free (babl_fish_db ());;
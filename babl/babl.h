@@ -97,6 +97,44 @@ const Babl * babl_format    (const char *name);
 const Babl * babl_fish      (const void *source_format,
                              const void *destination_format);
 
+/**
+ * babl_fish_with_tolerance:
+ *
+ *  Create a babl fish like babl_fish, that is allowed to introduce an
+ *  average relative error of up to tolerance, permitting faster but less
+ *  precise conversions, like interpolation in lookup tables. The tolerance
+ *  is rounded down to a power of ten, tolerances at or below the default
+ *  yield the fish babl_fish returns.
+ */
+const Babl * babl_fish_with_tolerance (const void *source_format,
+                                       const void *destination_format,
+                                       double      tolerance);
+
+/**
+ * babl_fish_with_budget:
+ *
+ *  Create a babl fish like babl_fish, spending at most msecs milliseconds
+ *  and measuring at most candidates paths on finding its path, 0 for no
+ *  limit. When the budget runs out the fish uses the best path found so
+ *  far, its search then being continued by babl_fish_continue_searches,
+ *  or is the reference fish when none was found yet, and later requests
+ *  for it continue the search with their own budget.
+ */
+const Babl * babl_fish_with_budget (const void *source_format,
+                                    const void *destination_format,
+                                    double      msecs,
+                                    int         candidates);
+
+/**
+ * babl_fish_continue_searches:
+ *
+ *  Continue the path searches of fishes which ran out of budget, for
+ *  instance when idle, spending at most msecs milliseconds, 0 for no
+ *  limit. Asking for such a fish returns it without continuing its
+ *  search. Returns the number of searches left unfinished.
+ */
+int          babl_fish_continue_searches (double msecs);
+
 /**
  * babl_process:
  *
@@ -108,6 +146,40 @@ long         babl_process   (const Babl *babl_fish,
                              void *destination,
                              long  n);
 
+/**
+ * babl_process_many:
+ *
+ *  Process count buffers with babl_fish, n[i] pixels from source[i] to
+ *  destination[i], setting up the conversion once for all of them. Returns
+ *  the total number of pixels converted.
+ */
+long         babl_process_many (const Babl  *babl_fish,
+                                const void **source,
+                                void       **destination,
+                                const long  *n,
+                                int          count);
+
+/**
+ * babl_warmup:
+ *
+ *  Measure the error and cost of every conversion between formats not
+ *  measured yet, which path searches otherwise measure as they need them,
+ *  using up to @threads threads. Loads every extension not loaded yet.
+ *  Returns the number of conversions measured.
+ */
+int          babl_warmup       (int          threads);
+
+/**
+ * babl_prewarm_from_profile:
+ *
+ *  Create the fishes listed in the profile at @path, written by babl_exit
+ *  when the environment variable BABL_FISH_PROFILE names it, ahead of
+ *  their first use, and finish the path searches which ran out of budget.
+ *  It can be called from another thread than the ones asking for fishes.
+ *  Returns the number of fishes created or found.
+ */
+int          babl_prewarm_from_profile (const char *path);
+
 
 /**
  * babl_get_name:
@@ -311,6 +383,123 @@ void   babl_set_user_data     (const Babl *babl, void *data);
 void * babl_get_user_data     (const Babl *babl);
 
 
+#define BABL_FISH_STATS_MAX_PATH 8
+
+/**
+ * BablFishStats: (skip)
+ *
+ * A snapshot of the statistics of a fish, the strings stay valid until
+ * babl_exit.
+ */
+typedef struct _BablFishStats
+{
+  const Babl  *fish;
+  const char  *source;       /* name of the source format */
+  const char  *destination;  /* name of the destination format */
+  const char  *kind;         /* the class of fish, like "BablFishPath" */
+  long         processings;  /* number of babl_process calls */
+  long         pixels;       /* number of pixels converted */
+  long         usecs;        /* wall time, estimated from timed calls */
+  double       ns_per_pixel; /* of the timed calls, 0.0 if none were */
+  double       error;        /* relative error measured on the test pixels */
+  double       tolerance;    /* the error it was allowed, 0.0 for the default */
+  int          path_length;  /* number of conversions of a path fish */
+  const char  *path[BABL_FISH_STATS_MAX_PATH]; /* names of the conversions */
+  long long    path_nsecs[BABL_FISH_STATS_MAX_PATH]; /* timed nsecs in each */
+  long         memory;       /* bytes held by the fish */
+} BablFishStats;
+
+typedef int (*BablFishStatsFunc) (const BablFishStats *stats,
+                                  void                *user_data);
+
+/**
+ * babl_fish_get_stats: (skip)
+ *
+ * Fill in @stats with the current statistics of @fish. Returns 0 if @fish
+ * isn't a fish.
+ */
+int    babl_fish_get_stats      (const Babl        *fish,
+                                 BablFishStats     *stats);
+
+/**
+ * babl_fish_stats_foreach: (skip)
+ *
+ * Call @func with a snapshot of the statistics of each fish created so far,
+ * until it returns non zero. No new fishes are created, thus this can be
+ * called at any time, also from other threads than the ones doing
+ * conversions.
+ */
+void   babl_fish_stats_foreach  (BablFishStatsFunc  func,
+                                 void              *user_data);
+
+
+/**
+ * BablTraceEvent: (skip)
+ *
+ * The events reported to a #BablTraceFunc, with what its count is.
+ */
+typedef enum
+{
+  BABL_TRACE_FISH_HIT,           /* an existing fish was returned, 0 */
+  BABL_TRACE_FISH_MISS,          /* no fish existed yet, 0 */
+  BABL_TRACE_PATH_SEARCH_BEGIN,  /* a path search starts, 0 */
+  BABL_TRACE_PATH_SEARCH_END,    /* it ended, the candidate paths measured */
+  BABL_TRACE_PROCESS_BEGIN,      /* babl_process on a fish, the pixels */
+  BABL_TRACE_PROCESS_END,        /* it returned, the pixels */
+  BABL_TRACE_REFERENCE_FALLBACK  /* no path was found, 0 */
+} BablTraceEvent;
+
+typedef void (*BablTraceFunc) (BablTraceEvent  event,
+                               const Babl     *source,
+                               const Babl     *destination,
+                               long            count,
+                               void           *user_data);
+
+/**
+ * babl_set_trace_func: (skip)
+ *
+ * Set a function to be called on fish lookups, path searches, reference
+ * fallbacks and processing, or NULL to stop tracing. The function is called
+ * from the thread doing the work, path search events with a babl lock
+ * held, thus it should be quick and must not call into babl.
+ */
+void   babl_set_trace_func      (BablTraceFunc      func,
+                                 void              *user_data);
+
+
+/**
+ * BablStartupPhase: (skip)
+ *
+ * A phase of babl_init (), or the loading of an extension, with the time
+ * it took and the number of things it registered, not counting the phases
+ * nested within it. The name stays valid until babl_exit.
+ */
+typedef struct _BablStartupPhase
+{
+  const char  *name;        /* like "core", "sanity" or an extension path */
+  int          depth;       /* the number of phases it is nested within */
+  long long    nsecs;       /* wall time */
+  int          types;
+  int          components;
+  int          models;
+  int          formats;
+  int          conversions;
+} BablStartupPhase;
+
+typedef int (*BablStartupPhaseFunc) (const BablStartupPhase *phase,
+                                     void                   *user_data);
+
+/**
+ * babl_startup_profile_foreach: (skip)
+ *
+ * Call @func with each recorded startup phase, in the order they began,
+ * until it returns non zero. Phases are only recorded when the environment
+ * variable BABL_STARTUP_PROFILE is set when babl_init is called,
+ * extensions loaded on demand later are recorded as they load.
+ */
+void   babl_startup_profile_foreach (BablStartupPhaseFunc  func,
+                                     void                 *user_data);
+
 
 /*
  * Backwards compatibility stuff
@@ -0,0 +1,331 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* babl-gen-tables writes the lookup tables of an extension as constant
+ * arrays, computed while building instead of when the extension is
+ * loaded, letting processes share them in read only memory.
+ *
+ *   babl-gen-tables gggl|gimp-8bit|gegl-fixups|fast-float > header
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "base/util.h"
+
+#define PER_LINE  8
+
+static void
+begin (const char *type,
+       const char *name,
+       int         size)
+{
+  printf ("\nstatic const %s %s[%i] =\n{", type, name, size);
+}
+
+static void
+separate (int i,
+          int size)
+{
+  if (i + 1 < size)
+    printf (",");
+  if (i + 1 == size || (i + 1) % PER_LINE == 0)
+    printf ("\n");
+}
+
+static void
+end (void)
+{
+  printf ("};\n");
+}
+
+/* floats are written in hexadecimal, which is exact */
+static void
+write_float (const char  *name,
+             const float *table,
+             int          size)
+{
+  int i;
+
+  begin ("float", name, size);
+  for (i = 0; i < size; i++)
+    {
+      printf (i % PER_LINE ? " %af" : "\n%af", table[i]);
+      separate (i, size);
+    }
+  end ();
+}
+
+static void
+write_u8 (const char          *name,
+          const unsigned char *table,
+          int                  size)
+{
+  int i;
+
+  begin ("unsigned char", name, size);
+  for (i = 0; i < size; i++)
+    {
+      printf (i % (PER_LINE * 2) ? " %i" : "\n%i", table[i]);
+      separate (i, size);
+    }
+  end ();
+}
+
+static void
+write_u16 (const char           *name,
+           const unsigned short *table,
+           int                   size)
+{
+  int i;
+
+  begin ("unsigned short", name, size);
+  for (i = 0; i < size; i++)
+    {
+      printf (i % (PER_LINE * 2) ? " %i" : "\n%i", table[i]);
+      separate (i, size);
+    }
+  end ();
+}
+
+/* u8 and u16 to and from float, indexing floats by their upper 16 bits,
+ * used by gggl and gggl-lies */
+static void
+gen_gggl (void)
+{
+  static float          table_8_F[1 << 8];
+  static float          table_16_F[1 << 16];
+  static unsigned char  table_F_8[1 << 16];
+  static unsigned short table_F_16[1 << 16];
+  union
+  {
+    float          f;
+    unsigned short s[2];
+  } u;
+  int i;
+
+  for (i = 0; i < 1 << 8; i++)
+    table_8_F[i] = (i * 1.0) / 255.0;
+  for (i = 0; i < 1 << 16; i++)
+    table_16_F[i] = (i * 1.0) / 65535.0;
+
+  u.f    = 0.0;
+  u.s[0] = 0x8000;
+  for (u.s[1] = 0; u.s[1] < 65535; u.s[1] += 1)
+    {
+      unsigned char  c;
+      unsigned short s;
+
+      if (u.f <= 0.0)
+        {
+          c = 0;
+          s = 0;
+        }
+      else if (u.f >= 1.0)
+        {
+          c = 255;
+          s = 65535;
+        }
+      else
+        {
+          c = lrint (u.f * 255.0);
+          s = lrint (u.f * 65535.0);
+        }
+      table_F_8[u.s[1]]  = c;
+      table_F_16[u.s[1]] = s;
+    }
+
+  write_float ("table_8_F", table_8_F, 1 << 8);
+  write_float ("table_16_F", table_16_F, 1 << 16);
+  write_u8 ("table_F_8", table_F_8, 1 << 16);
+  write_u16 ("table_F_16", table_F_16, 1 << 16);
+}
+
+static void
+gen_gimp_8bit (void)
+{
+  float lut_linear[1 << 8];
+  float lut_gamma_2_2[1 << 8];
+  int   i;
+
+  for (i = 0; i < 1 << 8; i++)
+    {
+      double value = i / 255.0;
+
+      lut_linear[i]    = value;
+      lut_gamma_2_2[i] = gamma_2_2_to_linear (value);
+    }
+
+  write_float ("lut_linear", lut_linear, 1 << 8);
+  write_float ("lut_gamma_2_2", lut_gamma_2_2, 1 << 8);
+}
+
+/* u8 and gamma corrected u8 to and from float, indexing floats by 17 of
+ * their bits */
+static void
+gen_gegl_fixups (void)
+{
+  static float         table_8_F[1 << 8];
+  static float         table_8g_F[1 << 8];
+  static unsigned char table_F_8[1 << 17];
+  static unsigned char table_F_8g[1 << 17];
+  union
+  {
+    float    f;
+    uint32_t s;
+  } u;
+  int i;
+
+  for (i = 0; i < 1 << 8; i++)
+    {
+      float direct = i / 255.0;
+
+      table_8_F[i]  = direct;
+      table_8g_F[i] = gamma_2_2_to_linear (direct);
+    }
+
+  for (u.s = 0; u.s < 4294900000U; u.s += 32768)
+    {
+      int c;
+      int cg;
+
+      if (u.f <= 0.0)
+        {
+          c  = 0;
+          cg = 0;
+        }
+      else
+        {
+          c  = (u.f * 255.1619) + 0.5;
+          cg = (linear_to_gamma_2_2 (u.f) * 255.1619) + 0.5;
+          if (cg > 255) cg = 255;
+          if (c > 255) c = 255;
+        }
+      table_F_8[(u.s >> 15) & ((1 << 17)-1)]  = c;
+      table_F_8g[(u.s >> 15) & ((1 << 17)-1)] = cg;
+    }
+
+  write_float ("table_8_F", table_8_F, 1 << 8);
+  write_float ("table_8g_F", table_8g_F, 1 << 8);
+  write_u8 ("table_F_8", table_F_8, 1 << 17);
+  write_u8 ("table_F_8g", table_F_8g, 1 << 17);
+}
+
+#define LSHIFT  2
+
+/* a table of function for positive floats from start to end, looked up
+ * by the bits of the float shifted right by shift, each entry holding
+ * the value for the middle of the floats sharing it */
+static void
+gen_lookup (const char *name,
+            double    (*function) (double value),
+            float       start,
+            float       end,
+            int         shift)
+{
+  union
+  {
+    float    f;
+    uint32_t i;
+  } u;
+  char      table_name[64];
+  uint32_t  positive_min;
+  uint32_t  positive_max;
+  float    *table;
+  uint32_t  i;
+
+  u.f          = start;
+  positive_min = (u.i << LSHIFT) >> shift;
+  u.f          = end;
+  positive_max = (u.i << LSHIFT) >> shift;
+
+  table = malloc (sizeof (float) * (positive_max - positive_min));
+  for (i = 0; i < positive_max - positive_min; i++)
+    {
+      u.i = ((positive_min + i) << (shift - LSHIFT)) +
+            (1 << (shift - LSHIFT - 1));
+      table[i] = function (u.f);
+    }
+
+  printf ("\n#define %s_SHIFT         %i\n", name, shift);
+  printf ("#define %s_POSITIVE_MIN  %u\n", name, positive_min);
+  printf ("#define %s_POSITIVE_MAX  %u\n", name, positive_max);
+  sprintf (table_name, "%s_table", name);
+  for (i = 0; table_name[i]; i++)
+    table_name[i] = tolower (table_name[i]);
+  write_float (table_name, table, positive_max - positive_min);
+  free (table);
+}
+
+static double
+gen_linear_to_gamma_2_2 (double value)
+{
+  return linear_to_gamma_2_2 (value);
+}
+
+static double
+gen_gamma_2_2_to_linear (double value)
+{
+  return gamma_2_2_to_linear (value);
+}
+
+/* the gamma curves between 0.0001 and 1.0, within 0.0001, with values
+ * close to 0 left to the functions */
+static void
+gen_fast_float (void)
+{
+  gen_lookup ("FAST_POW", gen_linear_to_gamma_2_2, 0.0001, 1.0, 12);
+  gen_lookup ("FAST_RPOW", gen_gamma_2_2_to_linear, 0.0001, 1.0, 12);
+}
+
+static const struct
+{
+  const char  *name;
+  void       (*gen) (void);
+} extensions[] =
+{
+  { "gggl",        gen_gggl },
+  { "gimp-8bit",   gen_gimp_8bit },
+  { "gegl-fixups", gen_gegl_fixups },
+  { "fast-float",  gen_fast_float },
+};
+
+int
+main (int    argc,
+      char **argv)
+{
+  int i;
+
+  for (i = 0; argc == 2 && i < (int) (sizeof (extensions) / sizeof (extensions[0])); i++)
+    if (!strcmp (argv[1], extensions[i].name))
+      {
+        printf ("/* lookup tables of %s, generated by babl-gen-tables */\n",
+                extensions[i].name);
+        extensions[i].gen ();
+        return 0;
+      }
+
+  fprintf (stderr, "usage: %s gggl|gimp-8bit|gegl-fixups|fast-float\n",
+           argv[0]);
+  return 1;
+}
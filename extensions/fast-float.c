@@ -32,32 +32,24 @@
 
 typedef  float (* BablLookupFunction) (float  value,
                                        void  *data);
-#define babl_LOOKUP_MAX_ENTRIES   (819200)
 
+/* a table of values of function, filled in for ranges of floats indexed
+ * by their bits shifted right by shift, other floats are passed to the
+ * function.
+ */
 typedef struct BablLookup
 {
   BablLookupFunction function;
   void              *data;
   int               shift;
   uint32_t            positive_min, positive_max, negative_min, negative_max;
-  uint32_t            bitmask[babl_LOOKUP_MAX_ENTRIES/32];
-  float             table[];
+  const float       *table;
 } BablLookup;
 
 
-static BablLookup *babl_lookup_new (BablLookupFunction  function,
-                                    void *              data,
-                                    float               start,
-                                    float               end,
-                                    float               precision);
-#if 0
-static void        babl_lookup_free      (BablLookup         *lookup);
-#endif
-
-
 static inline float
-babl_lookup (BablLookup *lookup,
-             float      number)
+babl_lookup (const BablLookup *lookup,
+             float             number)
 {
   union
   {
@@ -78,180 +70,51 @@ babl_lookup (BablLookup *lookup,
   else
     return lookup->function (number, lookup->data);
 
-  if (!(lookup->bitmask[i/32] & (1<<(i & 31))))
-    {
-      /* XXX: should look up the value in the middle of the range
-       *      that yields a given value,
-       *
-       *      potentially even do linear interpolation between
-       *      the two neighbour values to get away with a tiny
-       *      lookup table.. 
-       */
-      lookup->table[i]= lookup->function (number, lookup->data);
-      lookup->bitmask[i/32] |= (1<<(i & 31));
-    }
-
   return lookup->table[i];
 }
 
-static BablLookup *
-babl_lookup_new (BablLookupFunction function,
-                 void *             data,
-                 float              start,
-                 float              end,
-                 float              precision)
-{
-  BablLookup *lookup;
-  union
-  {
-    float   f;
-    uint32_t i;
-  } u;
-  int positive_min, positive_max, negative_min, negative_max;
-  int shift;
-
-  /* normalize input parameters */
-  if (start > end)
-    { /* swap */
-      u.f = start;
-      start = end;
-      end = u.f;
-    }
-
-       if (precision <= 0.000005) shift =  0; /* checked for later */
-  else if (precision <= 0.000010) shift =  8;
-  else if (precision <= 0.000020) shift =  9;
-  else if (precision <= 0.000040) shift = 10;
-  else if (precision <= 0.000081) shift = 11;
-  else if (precision <= 0.000161) shift = 12;
-  else if (precision <= 0.000324) shift = 14;
-  else if (precision <= 0.000649) shift = 15;
-  else shift = 16; /* a bit better than 8bit sRGB quality */
-
-  /* Adjust slightly away from 0.0, saving many entries close to 0, this
-   * causes lookups very close to zero to be passed directly to the
-   * function instead.
-   */
-  if (start == 0.0)
-    start = precision;
-  if (end == 0.0)
-    end = -precision;
-
-  /* Compute start and */
-
-  if (start < 0.0 || end < 0.0)
-    {
-      if (end < 0.0)
-        {
-          u.f = start;
-          positive_max = (u.i << LSHIFT) >> shift;
-          u.f = end;
-          positive_min = (u.i << LSHIFT) >> shift;
-          negative_min = positive_max;
-          negative_max = positive_max;
-        }
-      else
-        {
-          u.f = 0 - precision;
-          positive_min = (u.i << LSHIFT) >> shift;
-          u.f = start;
-          positive_max = (u.i << LSHIFT) >> shift;
-
-          u.f = 0 + precision;
-          negative_min = (u.i << LSHIFT) >> shift;
-          u.f = end;
-          negative_max = (u.i << LSHIFT) >> shift;
-        }
-    }
-  else
-    {
-      u.f = start;
-      positive_min = (u.i << LSHIFT) >> shift;
-      u.f = end;
-      positive_max = (u.i << LSHIFT) >> shift;
-      negative_min = positive_max;
-      negative_max = positive_max;
-    }
-
-  if (shift == 0) /* short circuit, do not use ranges */
-    {
-      positive_min = positive_max = negative_min = negative_max = 0;
-    }
-
-  if ((positive_max-positive_min) + (negative_max-negative_min) > babl_LOOKUP_MAX_ENTRIES)
-    {
-      /* Reduce the size of the cache tables to fit within the bittable
-       * budget (the maximum allocation is around 2.18mb of memory
-       */
-
-      int diff = (positive_max-positive_min) + (negative_max-negative_min) - babl_LOOKUP_MAX_ENTRIES;
-
-      if (negative_max - negative_min > 0)
-        {
-          if (negative_max - negative_min >= diff)
-            {
-              negative_max -= diff;
-              diff = 0;
-            }
-          else
-            {
-              diff -= negative_max - negative_min;
-              negative_max = negative_min;
-            }
-        }
-      if (diff)
-        positive_max-=diff;
-    }
-
-  lookup = calloc (sizeof (BablLookup) + sizeof (float) *
-                                                  ((positive_max-positive_min)+
-                                                   (negative_max-negative_min)), 1);
-
-  lookup->positive_min = positive_min;
-  lookup->positive_max = positive_max;
-  lookup->negative_min = negative_min;
-  lookup->negative_max = negative_max;
-  lookup->shift = shift;
-  lookup->function = function;
-  lookup->data = data;
-
-  return lookup;
-}
-
-static BablLookup *fast_pow = NULL;
+/* the tables hold the values for the middle of the range of floats
+ * sharing an entry, generated by babl-gen-tables */
+#include "fast-float-tables.h"
 
 static inline float core_lookup (float val, void *userdata)
 {
   return linear_to_gamma_2_2 (val);
 }
 
+static const BablLookup fast_pow =
+{
+  core_lookup, NULL, FAST_POW_SHIFT,
+  FAST_POW_POSITIVE_MIN, FAST_POW_POSITIVE_MAX,
+  FAST_POW_POSITIVE_MAX, FAST_POW_POSITIVE_MAX,
+  fast_pow_table
+};
+
 static float
 linear_to_gamma_2_2_lut (float val)
 {
-  return babl_lookup (fast_pow, val);
+  return babl_lookup (&fast_pow, val);
 }
 
 
-static BablLookup *fast_rpow = NULL;
-
 static inline float core_rlookup (float val, void *userdata)
 {
   return gamma_2_2_to_linear (val);
 }
 
-static float
-gamma_2_2_to_linear_lut (float val)
+static const BablLookup fast_rpow =
 {
-  return babl_lookup (fast_rpow, val);
-}
+  core_rlookup, NULL, FAST_RPOW_SHIFT,
+  FAST_RPOW_POSITIVE_MIN, FAST_RPOW_POSITIVE_MAX,
+  FAST_RPOW_POSITIVE_MAX, FAST_RPOW_POSITIVE_MAX,
+  fast_rpow_table
+};
 
-#if 0
-static void
-babl_lookup_free (BablLookup *lookup)
+static float
+gamma_2_2_to_linear_lut (float val)
 {
-  free (lookup);
+  return babl_lookup (&fast_rpow, val);
 }
-#endif
 
 static INLINE long
 conv_rgbaF_linear_rgbAF_gamma (unsigned char *src, 
@@ -442,23 +305,6 @@ init (void)
     babl_component ("B'"),
     NULL);
 
-  {
-    float f;
-    float a;
-
-    fast_pow = babl_lookup_new (core_lookup, NULL, 0.0, 1.0,   0.0001);
-    fast_rpow = babl_lookup_new (core_rlookup, NULL, 0.0, 1.0, 0.0001);
-
-    for (f = 0.0; f < 1.0; f+= 0.00001)
-      {
-        a = linear_to_gamma_2_2_lut (f);
-        a = gamma_2_2_to_linear_lut (f);
-      }
-    if (a < -10)
-      f = 2;
-
-  }
-
   o (rgbAF_linear, rgbAF_gamma);
   o (rgbaF_linear, rgbAF_gamma);
   o (rgbaF_linear, rgbaF_gamma);
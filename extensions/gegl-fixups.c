@@ -51,86 +51,9 @@
 
 #define INLINE    inline
 
-/* lookup tables used in conversion */
+/* lookup tables used in conversion, generated by babl-gen-tables */
 
-static float         table_8_F[1 << 8];
-static float         table_8g_F[1 << 8];
-static unsigned char table_F_8[1 << 17];
-static unsigned char table_F_8g[1 << 17];
-
-static int           table_inited = 0;
-
-static void
-table_init (void)
-{
-  if (table_inited)
-    return;
-  table_inited = 1;
-
-  /* fill tables for conversion from integer to float */
-  {
-    int i;
-    for (i = 0; i < 1 << 8; i++)
-      {
-        float direct = i / 255.0;
-        table_8_F[i]  = direct;
-        table_8g_F[i] = gamma_2_2_to_linear (direct);
-      }
-  }
-  /* fill tables for conversion from float to integer */
-  {
-    union
-    {
-      float    f;
-      uint32_t s;
-    } u;
-    u.f = 0.0;
-
-    //u.s[0] = 0;
-
-    for (u.s = 0; u.s < 4294900000U; u.s += 32768)
-      {
-        int c;
-        int cg;
-
-        if (u.f <= 0.0)
-          {
-            c  = 0;
-            cg = 0;
-          }
-        else
-          {
-            c  = (u.f * 255.1619) + 0.5;
-            cg = (linear_to_gamma_2_2 (u.f) * 255.1619) + 0.5;
-            if (cg > 255) cg = 255;
-            if (c > 255) c = 255;
-          }
-
-        table_F_8[(u.s >> 15) & ((1 << 17)-1)]  = c;
-        table_F_8g[(u.s >> 15) & ((1 << 17)-1)] = cg;
-      }
-  }
-#if 0
-  /* fix tables to ensure 1:1 conversions back and forth */
-  if (0)
-    {
-      int i;
-      for (i = 0; i < 256; i++)
-        {
-          float           f;
-          unsigned short *hi = ((unsigned short *) (void *) &f);
-          unsigned short *lo = ((unsigned short *) (void *) &f);
-
-          f = table_8_F[i];
-          *lo              = 0;
-          table_F_8[*hi] = i;
-          f  = table_8g_F[i];
-          *lo              = 0;
-          table_F_8g[*hi] = i;
-        }
-    }
-#endif
-}
+#include "gegl-fixups-tables.h"
 
 /* function to find the index in table for a float */
 static unsigned int
@@ -150,8 +73,6 @@ conv_F_8 (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       register float f = (*(float *) src);
@@ -168,8 +89,6 @@ conv_F_8g (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       register float f = (*(float *) src);
@@ -186,8 +105,6 @@ conv_8_F (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       (*(float *) dst) = table_8_F[*(unsigned char *) src];
@@ -542,8 +459,6 @@ init (void)
     babl_component ("B'"),
     NULL);
 
-  table_init ();
-
 #define o(src, dst) \
   babl_conversion_new (src, dst, "linear", conv_ ## src ## _ ## dst, NULL)
 
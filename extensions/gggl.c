@@ -51,87 +51,9 @@
 #define USE_TABLES
 #ifdef USE_TABLES
 
-/* lookup tables used in conversion */
+/* lookup tables used in conversion, generated by babl-gen-tables */
 
-static float          table_8_F[1 << 8];
-static float          table_16_F[1 << 16];
-static unsigned char  table_F_8[1 << 16];
-static unsigned short table_F_16[1 << 16];
-
-
-static int table_inited = 0;
-
-static void
-table_init (void)
-{
-  if (table_inited)
-    return;
-  table_inited = 1;
-
-  /* fill tables for conversion from integer to float */
-  {
-    int i;
-    for (i = 0; i < 1 << 8; i++)
-      {
-        table_8_F[i] = (i * 1.0) / 255.0;
-      }
-    for (i = 0; i < 1 << 16; i++)
-      table_16_F[i] = (i * 1.0) / 65535.0;
-  }
-  /* fill tables for conversion from float to integer */
-  {
-    union
-    {
-      float          f;
-      unsigned short s[2];
-    } u;
-    u.f = 0.0;
-
-    u.s[0] = 0x8000;
-
-    for (u.s[1] = 0; u.s[1] < 65535; u.s[1] += 1)
-      {
-        unsigned char  c;
-        unsigned short s;
-
-        if (u.f <= 0.0)
-          {
-            c = 0;
-            s = 0;
-          }
-        else if (u.f >= 1.0)
-          {
-            c = 255;
-            s = 65535;
-          }
-        else
-          {
-            c = lrint (u.f * 255.0);
-            s = lrint (u.f * 65535.0);
-          }
-
-        /*fprintf (stderr, "%2.3f=%03i %05i ", f, c, (*hi));
-           / if (! ((*hi)%9))
-           /         fprintf (stderr, "\n"); */
-
-        table_F_8[u.s[1]]  = c;
-        table_F_16[u.s[1]] = s;
-      }
-  }
-  /* fix tables to ensure 1:1 conversions back and forth */
-  if (0)
-    {                           /*FIXME: probably not the right way to do it,.. must sit down and scribble on paper */
-      int i;
-      for (i = 0; i < 256; i++)
-        {
-          float           f  = table_8_F[i];
-          unsigned short *hi = ((unsigned short *) (void *) &f);
-          unsigned short *lo = ((unsigned short *) (void *) &f);
-          *lo              = 0;
-          table_F_8[(*hi)] = i;
-        }
-    }
-}
+#include "gggl-tables.h"
 
 /* function to find the index in table for a float */
 static unsigned int
@@ -151,8 +73,6 @@ conv_F_8 (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       register float f = (*(float *) src);
@@ -168,8 +88,6 @@ conv_F_16 (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       register float f = (*(float *) src);
@@ -185,8 +103,6 @@ conv_8_F (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       (*(float *) dst) = table_8_F[*(unsigned char *) src];
@@ -201,8 +117,6 @@ conv_16_F (unsigned char *src, unsigned char *dst, long samples)
 {
   long n = samples;
 
-  if (!table_inited)
-    table_init ();
   while (n--)
     {
       (*(float *) dst) = table_16_F[*(unsigned short *) src];
@@ -1311,10 +1225,5 @@ init (void)
   o (rgbaF, rgbaD);
   o (rgbaD, rgbaF);
 
-#ifdef USE_TABLES
-  if (!table_inited)
-    table_init ();
-#endif
-
   return 0;
 }
@@ -30,26 +30,9 @@
 #define INLINE    inline
 
 
-/* lookup tables used in conversion */
+/* lookup tables used in conversion, generated by babl-gen-tables */
 
-static float lut_linear[1 << 8];
-static float lut_gamma_2_2[1 << 8];
-
-
-static void
-tables_init (void)
-{
-  int i;
-
-  /* fill tables for conversion from 8 bit integer to float */
-  for (i = 0; i < 1 << 8; i++)
-    {
-      double value = i / 255.0;
-
-      lut_linear[i]    = value;
-      lut_gamma_2_2[i] = gamma_2_2_to_linear (value);
-    }
-}
+#include "gimp-8bit-tables.h"
 
 static INLINE long
 u8_linear_to_float_linear (unsigned char *src,
@@ -476,8 +459,6 @@ init (void)
     babl_component ("Y'"),
     NULL);
 
-  tables_init ();
-
 #define o(src, dst) \
   babl_conversion_new (src, dst, "linear", conv_ ## src ## _ ## dst, NULL)
 
@@ -39,6 +39,7 @@ struct
   { BABL_CONVERSION_PLANAR, "BablConversionPlanar" },
   { BABL_FISH,              "BablFish"             },
   { BABL_FISH_REFERENCE,    "BablFishReference"    },
+  { BABL_FISH_LUT,          "BablFishLut"          },
   { BABL_IMAGE,             "BablImage"            },
   { BABL_SKY,               "BablSky"              },
   { 0,                      NULL                   }
@@ -48,7 +48,7 @@ static int destination_each (Babl *babl,
     printf (" ");
   else
     {
-      Babl *temp = babl_fish_path (source, destination);
+      Babl *temp = babl_fish_path (source, destination, 0.0);
 
       if (temp)
         {
@@ -0,0 +1,109 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "babl-internal.h"
+
+#define PIXELS 128
+
+static const char *used[][2] =
+{
+  { "R'G'B'A u8", "Y float" },
+  { "RGBA float", "CIE Lab float" },
+};
+
+#define USED ((int) (sizeof (used) / sizeof (used[0])))
+
+/* the advisor ranks the fishes the caller processed pixels with, not the
+ * ones path searches and error measurements made their test pixels with */
+int
+main (int    argc,
+      char **argv)
+{
+  static float  src[PIXELS * 4];
+  static float  dst[PIXELS * 4];
+  FILE         *report;
+  char          line[1024];
+  int           listed[USED] = { 0, };
+  int           ranked = 0;
+  int           OK     = 1;
+  int           i;
+
+  babl_init ();
+
+  for (i = 0; i < PIXELS * 4; i++)
+    src[i] = (i % 7) / 6.0;
+  for (i = 0; i < USED; i++)
+    babl_process (babl_fish (used[i][0], used[i][1]), src, dst, PIXELS);
+
+  report = tmpfile ();
+  if (!report)
+    return 1;
+  babl_fish_advise (report);
+  rewind (report);
+
+  while (fgets (line, sizeof (line), report))
+    {
+      char *end;
+      int   found = 0;
+
+      /* ranked fishes start with their rank */
+      strtol (line, &end, 10);
+      if (end == line || *end != ' ')
+        continue;
+      ranked++;
+
+      for (i = 0; i < USED; i++)
+        {
+          char pair[256];
+
+          snprintf (pair, sizeof (pair), " %s to %s (",
+                    used[i][0], used[i][1]);
+          if (strstr (line, pair))
+            {
+              listed[i]++;
+              found = 1;
+            }
+        }
+      if (!found)
+        {
+          printf ("not processed by the test: %s", line);
+          OK = 0;
+        }
+    }
+  fclose (report);
+
+  for (i = 0; i < USED; i++)
+    if (listed[i] != 1)
+      {
+        printf ("%s to %s listed %i times\n",
+                used[i][0], used[i][1], listed[i]);
+        OK = 0;
+      }
+  if (ranked != USED)
+    {
+      printf ("expected %i ranked fishes, got %i\n", USED, ranked);
+      OK = 0;
+    }
+
+  babl_exit ();
+  return !OK;
+}
@@ -0,0 +1,220 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define PROFILE_FILE  "fish-profile.txt"
+
+static const char *pairs[] =
+{
+  "R'G'B'A u8",    "RGBA float",
+  "RGBA float",    "R'G'B'A u8",
+  "Y' u8",         "RGBA float",
+  "CIE Lab float", "R'G'B' u8",
+};
+
+#define PAIRS  ((int) (sizeof (pairs) / sizeof (pairs[0]) / 2))
+#define THREADS 4
+
+static long misses;
+
+typedef struct
+{
+  int         pair;
+  const char *kinds[8];
+  int         counts[8];
+  int         kind_count;
+} PairFishes;
+
+static void
+trace (BablTraceEvent  event,
+       const Babl     *source,
+       const Babl     *destination,
+       long            count,
+       void           *user_data)
+{
+  if (event == BABL_TRACE_FISH_MISS)
+    misses++;
+}
+
+static int
+record_profile (void)
+{
+  const Babl *palette;
+  int         i;
+
+  babl_init ();
+  for (i = 0; i < PAIRS; i++)
+    babl_fish (pairs[i * 2], pairs[i * 2 + 1]);
+
+  /* not recorded, another process has other palettes */
+  babl_new_palette (NULL, &palette, NULL);
+  babl_fish (palette, babl_format ("Y float"));
+  babl_exit ();
+  return 0;
+}
+
+static int
+count_fish (const BablFishStats *stats,
+            void                *data)
+{
+  PairFishes *fishes = data;
+  int         i;
+
+  if (strcmp (stats->source, pairs[fishes->pair * 2]) ||
+      strcmp (stats->destination, pairs[fishes->pair * 2 + 1]))
+    return 0;
+
+  for (i = 0; i < fishes->kind_count; i++)
+    if (!strcmp (fishes->kinds[i], stats->kind))
+      break;
+  if (i == fishes->kind_count && i < 8)
+    {
+      fishes->kinds[i] = stats->kind;
+      fishes->kind_count++;
+    }
+  if (i < 8)
+    fishes->counts[i]++;
+  return 0;
+}
+
+static void *
+prewarm (void *data)
+{
+  *(int *) data = babl_prewarm_from_profile (PROFILE_FILE);
+  return NULL;
+}
+
+/* the fishes of a process but those of palettes are recorded, and
+ * another process creating them from the profile in a thread finds them
+ * all when it asks, asking for them while the thread creates them does
+ * not make them twice */
+int
+main (int    argc,
+      char **argv)
+{
+  char  command[1024];
+  char  line[1024];
+  FILE *file;
+  int   fishes = 0;
+  int   i;
+  int   OK = 1;
+
+  if (argc == 2 && !strcmp (argv[1], "--record"))
+    return record_profile ();
+
+  remove (PROFILE_FILE);
+  putenv ("BABL_FISH_PROFILE=" PROFILE_FILE);
+
+  /* babl can only be initialized once in a process */
+  snprintf (command, sizeof (command), "%s --record", argv[0]);
+  if (system (command) != 0)
+    {
+      printf ("recording the profile failed\n");
+      OK = 0;
+    }
+
+  file = fopen (PROFILE_FILE, "r");
+  while (file && fgets (line, sizeof (line), file))
+    if (strstr (line, "babl-int-"))
+      {
+        printf ("the fish of a palette was recorded: %s", line);
+        OK = 0;
+      }
+  if (file)
+    fclose (file);
+
+  babl_init ();
+
+#ifndef _WIN32
+  {
+    pthread_t thread[THREADS];
+    int       prewarmed[THREADS] = { 0, };
+    int       started = 0;
+
+    /* the threads go through the profile in the same order, asking for
+     * the same fishes at once */
+    for (i = 0; i < THREADS; i++)
+      if (!pthread_create (&thread[started], NULL, prewarm, &prewarmed[started]))
+        started++;
+    if (!started)
+      prewarm (&prewarmed[0]);
+
+    /* asking for the fishes while the threads create them */
+    for (i = 0; i < PAIRS; i++)
+      babl_fish (pairs[i * 2], pairs[i * 2 + 1]);
+    for (i = 0; i < started; i++)
+      pthread_join (thread[i], NULL);
+    fishes = prewarmed[0];
+  }
+#else
+  prewarm (&fishes);
+#endif
+
+  /* fishes created by extensions for their conversions are included */
+  if (fishes < PAIRS)
+    {
+      printf ("expected %i fishes from the profile, got %i\n", PAIRS, fishes);
+      OK = 0;
+    }
+
+  /* a fish made by both threads is made once */
+  for (i = 0; i < PAIRS; i++)
+    {
+      PairFishes fishes = { i, };
+      int        k;
+
+      babl_fish_stats_foreach (count_fish, &fishes);
+      for (k = 0; k < fishes.kind_count; k++)
+        if (fishes.counts[k] != 1)
+          {
+            printf ("%s to %s has %i fishes of %s\n",
+                    pairs[i * 2], pairs[i * 2 + 1], fishes.counts[k],
+                    fishes.kinds[k]);
+            OK = 0;
+          }
+      if (!fishes.kind_count)
+        {
+          printf ("%s to %s has no fish\n", pairs[i * 2], pairs[i * 2 + 1]);
+          OK = 0;
+        }
+    }
+
+  babl_set_trace_func (trace, NULL);
+  for (i = 0; i < PAIRS; i++)
+    babl_fish (pairs[i * 2], pairs[i * 2 + 1]);
+  babl_set_trace_func (NULL, NULL);
+  if (misses)
+    {
+      printf ("%li fishes were not created ahead\n", misses);
+      OK = 0;
+    }
+
+  babl_exit ();
+  remove (PROFILE_FILE);
+
+  return !OK;
+}
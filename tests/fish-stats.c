@@ -0,0 +1,94 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+#define PIXELS 128
+
+typedef struct
+{
+  int  fishes;
+  long pixels;   /* pixels of the R'G'B'A u8 to RGBA float fish */
+  int  calls;
+  int  path_length;
+} Counts;
+
+static int
+count_each (const BablFishStats *stats,
+            void                *data)
+{
+  Counts *counts = data;
+
+  counts->fishes++;
+  if (!strcmp (stats->source, "R'G'B'A u8") &&
+      !strcmp (stats->destination, "RGBA float"))
+    {
+      counts->pixels      = stats->pixels;
+      counts->calls       = stats->processings;
+      counts->path_length = stats->path_length;
+    }
+  return 0;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  unsigned char src[PIXELS * 4] = { 0, };
+  float         dst[PIXELS * 4];
+  Counts        before = { 0, };
+  Counts        after  = { 0, };
+  Counts        again  = { 0, };
+  int           OK     = 1;
+
+  babl_init ();
+
+  babl_fish_stats_foreach (count_each, &before);
+
+  babl_process (babl_fish ("R'G'B'A u8", "RGBA float"), src, dst, PIXELS);
+  babl_process (babl_fish ("R'G'B'A u8", "RGBA float"), src, dst, PIXELS);
+
+  babl_fish_stats_foreach (count_each, &after);
+  babl_fish_stats_foreach (count_each, &again);
+
+  if (after.pixels != before.pixels + 2 * PIXELS ||
+      after.calls != before.calls + 2)
+    {
+      printf ("expected %i more pixels in 2 more calls, got %li in %i\n",
+              2 * PIXELS, after.pixels - before.pixels,
+              after.calls - before.calls);
+      OK = 0;
+    }
+  if (after.path_length < 1)
+    {
+      printf ("expected the fish to be a path\n");
+      OK = 0;
+    }
+  /* taking a snapshot must not create fishes */
+  if (again.fishes != after.fishes)
+    {
+      printf ("fishes changed from %i to %i\n", after.fishes, again.fishes);
+      OK = 0;
+    }
+
+  babl_exit ();
+  return !OK;
+}
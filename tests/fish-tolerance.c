@@ -0,0 +1,70 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include "babl.h"
+
+#define SOURCE      "R'G'B' u8"
+#define DESTINATION "CIE Lab float"
+
+/* fishes made for a tolerance stay within it, and are kept apart from the
+ * fishes babl_fish returns */
+int
+main (int    argc,
+      char **argv)
+{
+  const Babl    *exact;
+  const Babl    *lossy;
+  BablFishStats  stats;
+  int            OK = 1;
+
+  babl_init ();
+
+  exact = babl_fish (SOURCE, DESTINATION);
+  lossy = babl_fish_with_tolerance (SOURCE, DESTINATION, 0.015);
+
+  if (babl_fish_with_tolerance (SOURCE, DESTINATION, 0.01) != lossy)
+    {
+      printf ("tolerances of the same power of ten got different fishes\n");
+      OK = 0;
+    }
+  if (babl_fish_with_tolerance (SOURCE, DESTINATION, 0.0) != exact ||
+      babl_fish (SOURCE, DESTINATION) != exact)
+    {
+      printf ("the default fish changed\n");
+      OK = 0;
+    }
+
+  babl_fish_get_stats (lossy, &stats);
+  if (stats.error > 0.01)
+    {
+      printf ("%s fish error %f above its tolerance\n", stats.kind, stats.error);
+      OK = 0;
+    }
+  babl_fish_get_stats (exact, &stats);
+  if (stats.error > 0.000001 || stats.tolerance != 0.0)
+    {
+      printf ("default %s fish error %f\n", stats.kind, stats.error);
+      OK = 0;
+    }
+
+  babl_exit ();
+
+  return !OK;
+}
@@ -0,0 +1,112 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "babl.h"
+
+
+#define N_THREADS               8
+#define N_ITERATIONS_PER_THREAD 20
+#define N_PIXELS                (64 * 1024)
+
+static const Babl    *fish;
+static unsigned char  palette[256 * 4];
+static unsigned char  in[N_PIXELS * 4];
+static unsigned char  expected[N_PIXELS];
+static int            failures[N_THREADS];
+
+static void *
+palette_stress_test_thread_func (void *failed)
+{
+  static unsigned char result[N_THREADS][N_PIXELS];
+  unsigned char       *out = result[(int *) failed - failures];
+  int                  i;
+
+  for (i = 0; i < N_ITERATIONS_PER_THREAD; i++)
+    {
+      /* all threads convert into the same palette format, sharing its
+       * lookup cache.
+       */
+      babl_process (fish, in, out, N_PIXELS);
+      if (memcmp (out, expected, N_PIXELS))
+        *(int *) failed = 1;
+    }
+
+  return NULL;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  pthread_t     threads[N_THREADS];
+  unsigned int  seed = 23;
+  const Babl   *pal;
+  const Babl   *pal_u8;
+  int           OK = 1;
+  int           i;
+
+  babl_init ();
+
+  for (i = 0; i < 256 * 4; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      palette[i] = i % 4 == 3 ? 255 : (seed >> 16) & 0xff;
+    }
+  for (i = 0; i < N_PIXELS * 4; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      in[i] = (seed >> 16) & 0xff;
+    }
+
+  pal = babl_new_palette (NULL, &pal_u8, NULL);
+  babl_palette_set_palette (pal, babl_format ("RGBA u8"), palette, 256);
+  fish = babl_fish (babl_format ("RGBA u8"), pal_u8);
+
+  /* the result of a single thread is the reference */
+  babl_process (fish, in, expected, N_PIXELS);
+  babl_palette_set_palette (pal, babl_format ("RGBA u8"), palette, 256);
+
+  for (i = 0; i < N_THREADS; i++)
+    {
+      pthread_create (&threads[i],
+                      NULL, /* attr */
+                      palette_stress_test_thread_func,
+                      &failures[i]);
+    }
+
+  for (i = 0; i < N_THREADS; i++)
+    {
+      pthread_join (threads[i],
+                    NULL /* thread_return */);
+      if (failures[i])
+        {
+          printf ("thread %i got different results than a single thread\n", i);
+          OK = 0;
+        }
+    }
+
+  babl_exit ();
+
+  return !OK;
+}
@@ -19,6 +19,7 @@
 #include "config.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include <assert.h>
 #include "babl.h"
 #include "common.inc"
@@ -66,6 +67,80 @@ main (int    argc,
         in, out);
 #endif
   }
+  /* check expansion to float, with out of range indices clamped */
+  {
+    unsigned char in[]      = {0, 1, 2, 15, 200};
+    unsigned char out[][4]  = {{0,0,0,255},{127,0,0,255},{0,127,0,255},
+                               {255,255,255,255},{255,255,255,255}};
+    float         result[5 * 4];
+    const Babl   *palA;
+    int i;
+
+    babl_new_palette (NULL, &palA, NULL);
+    babl_process (babl_fish (palA, babl_format ("RGBA float")), in, result, 5);
+
+    for (i = 0; i < 5 * 4; i++)
+      if (fabs (result[i] - out[i / 4][i % 4] / 255.0) > 0.0001)
+        {
+          printf ("pal to RGBA float failed #%i[%i] got %f expected %f\n",
+                  i / 4, i % 4, result[i], out[i / 4][i % 4] / 255.0);
+          OK = 0;
+        }
+  }
+
+  /* check that lookups in a large palette yield the closest entry */
+  {
+    unsigned char palette[256 * 4];
+    unsigned char in[4096 * 4];
+    unsigned char out[4096];
+    unsigned int  seed = 42;
+    const Babl   *pal;
+    const Babl   *pal_u8;
+    int i;
+
+    for (i = 0; i < 256 * 4; i++)
+      {
+        seed = seed * 1103515245 + 12345;
+        palette[i] = i % 4 == 3 ? 255 : (seed >> 16) & 0xff;
+      }
+    for (i = 0; i < 4096 * 4; i++)
+      {
+        seed = seed * 1103515245 + 12345;
+        in[i] = (seed >> 16) & 0xff;
+      }
+
+    pal = babl_new_palette (NULL, &pal_u8, NULL);
+    babl_palette_set_palette (pal, babl_format ("RGBA u8"), palette, 256);
+    babl_process (babl_fish (babl_format ("RGBA u8"), pal_u8), in, out, 4096);
+
+    for (i = 0; i < 4096; i++)
+      {
+        int best_diff = 256 * 256 * 3;
+        int diff;
+        int j, c;
+
+        for (j = 0; j < 256; j++)
+          {
+            diff = 0;
+            for (c = 0; c < 3; c++)
+              diff += (in[i * 4 + c] - palette[j * 4 + c]) *
+                      (in[i * 4 + c] - palette[j * 4 + c]);
+            if (diff < best_diff)
+              best_diff = diff;
+          }
+
+        diff = 0;
+        for (c = 0; c < 3; c++)
+          diff += (in[i * 4 + c] - palette[out[i] * 4 + c]) *
+                  (in[i * 4 + c] - palette[out[i] * 4 + c]);
+        if (diff != best_diff)
+          {
+            printf ("nearest palette entry #%i: got %i at distance %i, expected distance %i\n",
+                    i, out[i], diff, best_diff);
+            OK = 0;
+          }
+      }
+  }
 #if 0
   {
     unsigned char in[][4]  = {{0,0,0,255},{140,0,0,255},{0,127,0,255}};
@@ -0,0 +1,141 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "babl.h"
+
+#define COSTS_FILE   "path-budget-costs.txt"
+#define SOURCE       "R'G'B'A u8"
+#define DESTINATION  "Y float"
+#define MAX_SIZE     4096
+
+static int searches;
+
+static void
+trace (BablTraceEvent  event,
+       const Babl     *source,
+       const Babl     *destination,
+       long            count,
+       void           *user_data)
+{
+  if (event == BABL_TRACE_PATH_SEARCH_BEGIN)
+    searches++;
+}
+
+/* babl can only be initialized once in a process, thus every search is
+ * made by running this test again, printing the path it ends up with */
+static int
+find_path (const char *test,
+           const char *how,
+           char       *path)
+{
+  char  command[1024];
+  FILE *child;
+  int   size;
+
+  snprintf (command, sizeof (command), "%s %s", test, how);
+  child = popen (command, "r");
+  if (!child)
+    return 0;
+  size = fread (path, 1, MAX_SIZE - 1, child);
+  path[size] = '\0';
+  pclose (child);
+  return size;
+}
+
+static int
+child_find_path (int budget)
+{
+  const Babl    *fish = NULL;
+  BablFishStats  stats;
+  int            i;
+
+  babl_init ();
+
+  if (budget)
+    {
+      /* a search measuring a single candidate, or taking next to no time,
+       * still yields a fish */
+      if (!babl_fish_with_budget (SOURCE, DESTINATION, 0.000001, 0))
+        printf ("no fish within a time budget\n");
+      for (i = 0; i < 8; i++)
+        if (!babl_fish_with_budget (SOURCE, DESTINATION, 0.0, 1))
+          printf ("no fish within a candidate budget\n");
+
+      /* asking for a fish with a path does not continue its search */
+      fish = babl_fish_with_budget (SOURCE, DESTINATION, 0.0, 1);
+      babl_set_trace_func (trace, NULL);
+      if (babl_fish (SOURCE, DESTINATION) != fish || searches)
+        printf ("a search continued on asking for the fish\n");
+      babl_set_trace_func (NULL, NULL);
+
+      /* continuing the searches completes them where they stopped */
+      if (babl_fish_continue_searches (0.0))
+        printf ("searches were left unfinished\n");
+    }
+  fish = babl_fish (SOURCE, DESTINATION);
+
+  babl_fish_get_stats (fish, &stats);
+  printf ("%s", stats.kind);
+  for (i = 0; i < stats.path_length && i < BABL_FISH_STATS_MAX_PATH; i++)
+    printf (" %s", stats.path[i]);
+  printf ("\n");
+
+  babl_exit ();
+  return 0;
+}
+
+/* a search spread over calls with small budgets, and continued when
+ * asked to, ends up with the path a single search finds */
+int
+main (int    argc,
+      char **argv)
+{
+  static char complete[MAX_SIZE];
+  static char resumed[MAX_SIZE];
+  int         OK = 1;
+
+  if (argc == 2 && !strcmp (argv[1], "--search"))
+    return child_find_path (0);
+  if (argc == 2 && !strcmp (argv[1], "--search-with-budget"))
+    return child_find_path (1);
+
+  remove (COSTS_FILE);
+  /* for the same path to be chosen every time */
+  putenv ("BABL_PATH_COSTS=" COSTS_FILE);
+
+  if (!find_path (argv[0], "--search", complete) ||
+      strncmp (complete, "BablFishPath ", 13))
+    {
+      printf ("unable to find a path: %s\n", complete);
+      OK = 0;
+    }
+  find_path (argv[0], "--search-with-budget", resumed);
+  if (strcmp (complete, resumed))
+    {
+      printf ("expected %s" "got %s", complete, resumed);
+      OK = 0;
+    }
+
+  remove (COSTS_FILE);
+
+  return !OK;
+}
@@ -0,0 +1,109 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "babl-internal.h"
+#include "babl-ref-pixels.h"
+
+#define SOURCE        "R'G'B'A u16"
+#define DESTINATION   "Y'A float"
+#define DESTINATION2  "CIE Lab float"
+
+/* the test pixels of a format and the reference conversions between two
+ * formats are made once, for the first search measuring paths from the
+ * format, or between the formats */
+int
+main (void)
+{
+  const Babl *source      = NULL;
+  const Babl *destination = NULL;
+  const void *reference;
+  const void *shared;
+  long        made;
+  int         OK          = 1;
+
+  babl_init ();
+
+  source      = babl_format (SOURCE);
+  destination = babl_format (DESTINATION);
+
+  made = babl_path_buffers_made ();
+  babl_fish_path (source, destination, 0.0);
+  if (babl_path_buffers_made () == made)
+    {
+      printf ("no buffers were made for measuring paths\n");
+      OK = 0;
+    }
+
+  /* another search between the same formats */
+  made = babl_path_buffers_made ();
+  babl_fish_path (source, destination, 0.0001);
+  if (babl_path_buffers_made () != made)
+    {
+      printf ("%li buffers were made again for the same formats\n",
+              babl_path_buffers_made () - made);
+      OK = 0;
+    }
+
+  /* a search from the same source only needs its reference */
+  made = babl_path_buffers_made ();
+  babl_fish_path (source, babl_format (DESTINATION2), 0.0);
+  if (babl_path_buffers_made () - made > 1)
+    {
+      printf ("%li buffers were made for a new destination\n",
+              babl_path_buffers_made () - made);
+      OK = 0;
+    }
+
+  /* the shared buffers are what the reference fishes make */
+  {
+    const int test_pixels = babl_get_num_path_test_pixels ();
+    int       bpp         = destination->format.bytes_per_pixel;
+    void     *src         = babl_malloc ((long) test_pixels *
+                                         source->format.bytes_per_pixel);
+    void     *dst         = babl_malloc ((long) test_pixels * bpp);
+
+    babl_process (babl_fish_reference (babl_format ("RGBA double"), source),
+                  babl_get_path_test_pixels (), src, test_pixels);
+    babl_process (babl_fish_reference (source, destination),
+                  src, dst, test_pixels);
+
+    shared    = babl_path_test_buffer (source);
+    reference = babl_path_reference (source, destination, NULL, NULL);
+    if (memcmp (shared, src, (long) test_pixels *
+                             source->format.bytes_per_pixel))
+      {
+        printf ("the shared test pixels differ from the reference\n");
+        OK = 0;
+      }
+    if (memcmp (reference, dst, (long) test_pixels * bpp))
+      {
+        printf ("the shared reference differs from the reference fish\n");
+        OK = 0;
+      }
+
+    babl_free (src);
+    babl_free (dst);
+  }
+
+  babl_exit ();
+
+  return !OK;
+}
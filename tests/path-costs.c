@@ -0,0 +1,270 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* Static path costs choose the same paths for the same costs and
+ * conversions. The conversions differ between machines though: extensions
+ * for particular CPUs, like the sse2-* ones, are only loaded where the CPU
+ * has the instructions, and so the chosen paths differ too. This test
+ * therefore forces a path through R'G'B'A float, which every machine has
+ * conversions for, with costs written for the conversions this machine
+ * has.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+#define COSTS_FILE   "path-costs.txt"
+#define FORCED_FILE  "path-costs-forced.txt"
+#define MAX_SIZE     4096
+
+#define SOURCE       "R'G'B'A u8"
+#define DESTINATION  "RGBA float"
+
+/* the forced path from SOURCE to DESTINATION, through R'G'B'A float */
+static const char *forced[] =
+{
+  ": R'G'B'A u8 to R'G'B'A float",
+  ": R'G'B'A float to RGBA float",
+};
+
+#define FORCED  ((int) (sizeof (forced) / sizeof (forced[0])))
+
+/* the direct conversions the forced path is to beat */
+#define DIRECT       ": R'G'B'A u8 to RGBA float"
+
+static int
+ends_with (const char *string,
+           const char *end)
+{
+  size_t length     = strlen (string);
+  size_t end_length = strlen (end);
+
+  return length >= end_length &&
+         !strcmp (string + length - end_length, end);
+}
+
+/* the table of costs is written on the first path search, and the paths
+ * found are within the tolerance like timed ones */
+static int
+child_measure (void)
+{
+  BablFishStats stats;
+  int           OK = 1;
+
+  babl_init ();
+
+  babl_fish_get_stats (babl_fish ("R'G'B'A u8", "Y float"), &stats);
+  if (strcmp (stats.kind, "BablFishPath") || stats.path_length < 1)
+    {
+      printf ("expected a path fish, got a %s\n", stats.kind);
+      OK = 0;
+    }
+  if (stats.error > 0.000001)
+    {
+      printf ("path error %f above the tolerance\n", stats.error);
+      OK = 0;
+    }
+
+  /* interpolating fishes are picked by timing them, not by the costs */
+  babl_fish_get_stats (babl_fish_with_tolerance (babl_format ("R'G'B' u8"),
+                                                 babl_format ("CIE Lab float"),
+                                                 0.01),
+                       &stats);
+  if (!strcmp (stats.kind, "BablFishLut"))
+    {
+      printf ("expected no interpolating fish with static costs\n");
+      OK = 0;
+    }
+
+  babl_exit ();
+  return !OK;
+}
+
+static int
+child_path (void)
+{
+  BablFishStats stats;
+  int           i;
+
+  babl_init ();
+
+  babl_fish_get_stats (babl_fish (SOURCE, DESTINATION), &stats);
+  printf ("%s\n", stats.kind);
+  for (i = 0; i < stats.path_length && i < BABL_FISH_STATS_MAX_PATH; i++)
+    printf ("%s\n", stats.path[i]);
+
+  babl_exit ();
+  return 0;
+}
+
+/* babl can only be initialized once in a process, thus every table of
+ * costs is used by running this test again */
+static int
+run (const char *test,
+     const char *costs,
+     const char *mode,
+     char       *output)
+{
+  char  command[1024];
+  FILE *child;
+  int   size;
+
+  snprintf (command, sizeof (command), "BABL_PATH_COSTS=%s %s %s",
+            costs, test, mode);
+  child = popen (command, "r");
+  if (!child)
+    return -1;
+  size = fread (output, 1, MAX_SIZE - 1, child);
+  output[size] = '\0';
+  return pclose (child);
+}
+
+/* writes a table of costs making the conversions of the forced path the
+ * cheapest, from the names of the measured table */
+static int
+write_forced (void)
+{
+  FILE *measured = fopen (COSTS_FILE, "r");
+  FILE *file;
+  char  line[1024];
+  int   found    = 0;
+  int   i;
+
+  if (!measured)
+    return 0;
+  file = fopen (FORCED_FILE, "w");
+  if (!file)
+    {
+      fclose (measured);
+      return 0;
+    }
+
+  fprintf (file, "# hand written costs forcing a path\n");
+  while (fgets (line, sizeof (line), measured))
+    {
+      char *name = strchr (line, ' ');
+
+      line[strcspn (line, "\r\n")] = '\0';
+      if (line[0] == '#' || !name)
+        continue;
+      name++;
+
+      if (ends_with (name, DIRECT))
+        fprintf (file, "1000 %s\n", name);
+      for (i = 0; i < FORCED; i++)
+        if (ends_with (name, forced[i]))
+          {
+            fprintf (file, "0.0001 %s\n", name);
+            found |= 1 << i;
+          }
+    }
+  fclose (measured);
+  fclose (file);
+  return found == (1 << FORCED) - 1;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  static char output[MAX_SIZE];
+  static char first[MAX_SIZE];
+  FILE       *file;
+  char        line[1024];
+  int         lines = 0;
+  int         OK    = 1;
+  int         i;
+
+  if (argc == 2 && !strcmp (argv[1], "--measure"))
+    return child_measure ();
+  if (argc == 2 && !strcmp (argv[1], "--path"))
+    return child_path ();
+
+  remove (COSTS_FILE);
+  remove (FORCED_FILE);
+
+  if (run (argv[0], COSTS_FILE, "--measure", output))
+    {
+      printf ("%s", output);
+      OK = 0;
+    }
+
+  file = fopen (COSTS_FILE, "r");
+  if (file)
+    {
+      while (fgets (line, sizeof (line), file))
+        if (line[0] != '#')
+          lines++;
+      fclose (file);
+    }
+  if (lines == 0)
+    {
+      printf ("no costs were written to %s\n", COSTS_FILE);
+      OK = 0;
+    }
+
+  if (!write_forced ())
+    {
+      printf ("the conversions of the forced path are missing\n");
+      OK = 0;
+    }
+  else
+    {
+      char *path[FORCED + 2];
+      int   length = 0;
+      char *item;
+
+      /* the same path is chosen every time, the one the costs force */
+      run (argv[0], FORCED_FILE, "--path", first);
+      run (argv[0], FORCED_FILE, "--path", output);
+      if (strcmp (first, output))
+        {
+          printf ("the paths of two runs differ:\n%s" "and\n%s", first, output);
+          OK = 0;
+        }
+
+      /* the kind of the fish, then its conversions */
+      for (item = strtok (output, "\n"); item && length < FORCED + 2;
+           item = strtok (NULL, "\n"))
+        path[length++] = item;
+
+      if (length != FORCED + 1 || strcmp (path[0], "BablFishPath"))
+        {
+          printf ("expected a path of %i conversions, got\n%s", FORCED, first);
+          OK = 0;
+        }
+      else
+        {
+          for (i = 0; i < FORCED; i++)
+            if (!ends_with (path[i + 1], forced[i]))
+              {
+                printf ("expected a conversion ending in \"%s\", got %s\n",
+                        forced[i], path[i + 1]);
+                OK = 0;
+              }
+        }
+    }
+
+  remove (COSTS_FILE);
+  remove (FORCED_FILE);
+
+  return !OK;
+}
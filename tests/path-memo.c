@@ -0,0 +1,158 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "babl-internal.h"
+
+#define COSTS_FILE  "path-memo-costs.txt"
+#define MAX_SIZE    65536
+#define MAX_LINE    1024
+
+static const char *formats[] =
+{
+  "R'G'B'A u8",
+  "R'G'B' u8",
+  "RGBA u16",
+  "R'G'B'A u16",
+  "RGBA float",
+  "R'G'B'A float",
+  "RGB float",
+  "Y u8",
+  "Y' u8",
+  "Y'A u8",
+  "Y float",
+  NULL
+};
+
+/* babl can only be initialized once in a process, thus every matrix of
+ * searches is made by running this test again, printing the paths */
+static int
+find_paths (const char *test,
+            const char *memo,
+            char       *paths)
+{
+  char  command[1024];
+  FILE *child;
+  int   size;
+
+  snprintf (command, sizeof (command), "BABL_PATH_MEMO=%s %s --find-paths",
+            memo, test);
+  child = popen (command, "r");
+  if (!child)
+    return 0;
+  size = fread (paths, 1, MAX_SIZE - 1, child);
+  paths[size] = '\0';
+  pclose (child);
+  return size;
+}
+
+static int
+child_find_paths (void)
+{
+  int s, d;
+
+  babl_init ();
+
+  for (s = 0; formats[s]; s++)
+    for (d = 0; formats[d]; d++)
+      if (s != d)
+        {
+          Babl          *fish = babl_fish_path (babl_format (formats[s]),
+                                                babl_format (formats[d]), 0.0);
+          BablFishStats  stats;
+          char           line[MAX_LINE];
+          int            length;
+          int            p;
+
+          length = snprintf (line, MAX_LINE, "%s -> %s:",
+                             formats[s], formats[d]);
+          if (fish)
+            {
+              babl_fish_get_stats (fish, &stats);
+              length += snprintf (line + length, MAX_LINE - length, " %s",
+                                  stats.kind);
+              for (p = 0;
+                   p < stats.path_length && p < BABL_FISH_STATS_MAX_PATH;
+                   p++)
+                length += snprintf (line + length, MAX_LINE - length,
+                                    " [%s]", stats.path[p]);
+            }
+          else
+            {
+              snprintf (line + length, MAX_LINE - length, " none");
+            }
+          printf ("%s\n", line);
+        }
+  printf ("memo hits %li\n", babl_path_memo_hits ());
+
+  babl_exit ();
+  return 0;
+}
+
+/* with static costs, searches taking the remembered paths find the same
+ * paths as searches considering every path */
+int
+main (int    argc,
+      char **argv)
+{
+  static char exhaustive[MAX_SIZE];
+  static char memoized[MAX_SIZE];
+  char       *hits;
+  int         OK = 1;
+
+  if (argc == 2 && !strcmp (argv[1], "--find-paths"))
+    return child_find_paths ();
+
+  remove (COSTS_FILE);
+  /* for the same paths to be chosen every time */
+  putenv ("BABL_PATH_COSTS=" COSTS_FILE);
+
+  /* the first run writes the costs both use */
+  find_paths (argv[0], "0", exhaustive);
+  find_paths (argv[0], "0", exhaustive);
+  find_paths (argv[0], "1", memoized);
+
+  hits = strstr (memoized, "memo hits ");
+  if (!hits || atol (hits + 10) <= 0)
+    {
+      printf ("the searches did not take any remembered paths\n");
+      OK = 0;
+    }
+  if (hits)
+    *hits = '\0';
+  hits = strstr (exhaustive, "memo hits ");
+  if (!hits || atol (hits + 10) != 0)
+    {
+      printf ("paths were remembered with BABL_PATH_MEMO=0\n");
+      OK = 0;
+    }
+  if (hits)
+    *hits = '\0';
+
+  if (!strstr (exhaustive, "->") || strcmp (exhaustive, memoized))
+    {
+      printf ("expected paths for\n%s" "got\n%s", exhaustive, memoized);
+      OK = 0;
+    }
+
+  remove (COSTS_FILE);
+
+  return !OK;
+}
@@ -0,0 +1,139 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "babl.h"
+
+#define COSTS_FILE  "path-order-costs.txt"
+#define MAX_SIZE    65536
+#define MAX_LINE    1024
+
+static const char *formats[] =
+{
+  "R'G'B'A u8",
+  "R'G'B' u8",
+  "RGBA u16",
+  "R'G'B'A u16",
+  "RGBA float",
+  "Y u8",
+  "Y' u8",
+  "Y'A u8",
+  "Y float",
+  "CIE Lab float",
+  NULL
+};
+
+/* babl can only be initialized once in a process, thus every order of
+ * requests is made by running this test again, printing the paths */
+static int
+find_paths (const char *test,
+            const char *order,
+            char       *paths)
+{
+  char  command[1024];
+  FILE *child;
+  int   size;
+
+  snprintf (command, sizeof (command), "%s %s", test, order);
+  child = popen (command, "r");
+  if (!child)
+    return 0;
+  size = fread (paths, 1, MAX_SIZE - 1, child);
+  paths[size] = '\0';
+  pclose (child);
+  return size;
+}
+
+static int
+child_find_paths (int reverse)
+{
+  static char  lines[16][16][MAX_LINE];
+  int          count = 0;
+  int          i, s, d;
+
+  while (formats[count])
+    count++;
+
+  babl_init ();
+
+  for (i = 0; i < count * count; i++)
+    {
+      int            pair = reverse ? count * count - 1 - i : i;
+      BablFishStats  stats;
+      int            length;
+      int            p;
+
+      s = pair / count;
+      d = pair % count;
+      if (s == d)
+        continue;
+
+      babl_fish_get_stats (babl_fish (formats[s], formats[d]), &stats);
+      length = snprintf (lines[s][d], MAX_LINE, "%s -> %s: %s",
+                         formats[s], formats[d], stats.kind);
+      for (p = 0; p < stats.path_length && p < BABL_FISH_STATS_MAX_PATH; p++)
+        length += snprintf (lines[s][d] + length, MAX_LINE - length,
+                            " [%s]", stats.path[p]);
+    }
+
+  /* printed in the same order whatever the order of the requests */
+  for (s = 0; s < count; s++)
+    for (d = 0; d < count; d++)
+      if (s != d)
+        printf ("%s\n", lines[s][d]);
+
+  babl_exit ();
+  return 0;
+}
+
+/* with static costs the path of a pair does not depend on the fishes made
+ * before it */
+int
+main (int    argc,
+      char **argv)
+{
+  static char forward[MAX_SIZE];
+  static char reverse[MAX_SIZE];
+  int         OK = 1;
+
+  if (argc == 2 && !strcmp (argv[1], "--forward"))
+    return child_find_paths (0);
+  if (argc == 2 && !strcmp (argv[1], "--reverse"))
+    return child_find_paths (1);
+
+  remove (COSTS_FILE);
+  putenv ("BABL_PATH_COSTS=" COSTS_FILE);
+
+  /* the first run writes the costs both use */
+  find_paths (argv[0], "--forward", forward);
+  find_paths (argv[0], "--forward", forward);
+  find_paths (argv[0], "--reverse", reverse);
+
+  if (!strstr (forward, "->") || strcmp (forward, reverse))
+    {
+      printf ("expected paths for\n%s" "got\n%s", forward, reverse);
+      OK = 0;
+    }
+
+  remove (COSTS_FILE);
+
+  return !OK;
+}
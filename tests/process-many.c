@@ -0,0 +1,92 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+#define BUFFERS 7
+#define PIXELS  2000
+
+/* converting buffers at once gives the same pixels as one at a time */
+static int
+test_many (const char *source_format,
+           const char *destination_format)
+{
+  const Babl    *fish = babl_fish (source_format, destination_format);
+  int            src_bpp = babl_format_get_bytes_per_pixel (babl_format (source_format));
+  static unsigned char src[BUFFERS][PIXELS * 16];
+  static unsigned char dst[BUFFERS][PIXELS * 16];
+  static unsigned char ref[BUFFERS][PIXELS * 16];
+  const void    *sources[BUFFERS];
+  void          *destinations[BUFFERS];
+  long           n[BUFFERS] = { 1, 64, 0, 4096 / 4, 1025, PIXELS, 3 };
+  long           total = 0;
+  int            i, j;
+  int            OK = 1;
+
+  for (i = 0; i < BUFFERS; i++)
+    {
+      for (j = 0; j < PIXELS * src_bpp; j++)
+        src[i][j] = (i * 31 + j * 7) & 0xff;
+      if (strstr (source_format, "float"))
+        for (j = 0; j < PIXELS * src_bpp / 4; j++)
+          ((float *) src[i])[j] = ((i * 31 + j * 7) % 256) / 255.0f;
+      memset (dst[i], 0, sizeof (dst[i]));
+      memset (ref[i], 0, sizeof (ref[i]));
+      if (n[i])
+        babl_process (fish, src[i], ref[i], n[i]);
+      sources[i]      = src[i];
+      destinations[i] = dst[i];
+      total          += n[i];
+    }
+
+  if (babl_process_many (fish, sources, destinations, n, BUFFERS) != total)
+    {
+      printf ("%s to %s: wrong pixel count\n", source_format, destination_format);
+      OK = 0;
+    }
+  for (i = 0; i < BUFFERS; i++)
+    if (memcmp (dst[i], ref[i], sizeof (dst[i])))
+      {
+        printf ("%s to %s: buffer %i differs\n",
+                source_format, destination_format, i);
+        OK = 0;
+      }
+  return OK;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  int OK = 1;
+
+  babl_init ();
+
+  OK &= test_many ("R'G'B'A u8", "RGBA float");
+  OK &= test_many ("Y' u8", "R'G'B'A u8");
+  OK &= test_many ("RGBA float", "R'G'B'A u16");
+  OK &= test_many ("R'G'B' u8", "CIE Lab float");
+  OK &= test_many ("R'G'B' u8", "R'G'B' u8");
+
+  babl_exit ();
+
+  return !OK;
+}
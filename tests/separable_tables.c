@@ -0,0 +1,97 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include "babl-internal.h"
+
+#define PIXELS       1024
+#define TOLERANCE    1
+
+unsigned char  source_buf [PIXELS * 4];
+unsigned short reference_buf [PIXELS * 4];
+unsigned short destination_buf [PIXELS * 4];
+
+/* per component tables are registered for these pairs when no direct
+ * conversion exists, they should agree with the reference conversion.
+ */
+static int
+test_pair (const char *source_name,
+           const char *destination_name,
+           int         source_components,
+           int         components)
+{
+  const Babl *source      = babl_format (source_name);
+  const Babl *destination = babl_format (destination_name);
+  const Babl *table;
+  int         i;
+  int         OK          = 1;
+
+  for (i = 0; i < PIXELS * source_components; i++)
+    source_buf[i] = (i * 7 + i / source_components) & 0xff;
+
+  babl_process (babl_fish (source, destination),
+                source_buf, destination_buf, PIXELS);
+  babl_process (babl_fish_reference (source, destination),
+                source_buf, reference_buf, PIXELS);
+
+  for (i = 0; i < PIXELS * components; i++)
+    {
+      if (abs (destination_buf[i] - reference_buf[i]) > TOLERANCE)
+        {
+          babl_log ("%s to %s: %4i is %i should be %i",
+                    source_name, destination_name,
+                    i, destination_buf[i], reference_buf[i]);
+          OK = 0;
+        }
+    }
+
+  table = babl_conversion_find (source, destination);
+  if (!table || !babl_conversion_is_table (table))
+    {
+      babl_log ("%s to %s: no table was made", source_name, destination_name);
+      OK = 0;
+    }
+  return OK;
+}
+
+static int
+test (void)
+{
+  int OK = 1;
+
+  OK &= test_pair ("Y u8", "Y' u16", 1, 1);
+  OK &= test_pair ("R'G'B' u8", "RGB u16", 3, 3);
+  OK &= test_pair ("R'G'B'A u8", "RGBA u16", 4, 4);
+  /* with the alpha the destination adds */
+  OK &= test_pair ("R'G'B' u8", "RGBA u16", 3, 4);
+  if (!OK)
+    return -1;
+  return 0;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  babl_init ();
+  if (test ())
+    return -1;
+  babl_exit ();
+  return 0;
+}
@@ -0,0 +1,179 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+#define SNAPSHOT_FILE  "snapshot.txt"
+#define COSTS_FILE     "snapshot-costs.txt"
+#define MAX_SIZE       65536
+
+static int
+read_file (char *contents)
+{
+  FILE *file = fopen (SNAPSHOT_FILE, "r");
+  int   size;
+
+  if (!file)
+    return 0;
+  size = fread (contents, 1, MAX_SIZE - 1, file);
+  contents[size] = '\0';
+  fclose (file);
+  return size;
+}
+
+/* babl can only be initialized once in a process, thus every search is
+ * made by running this test again */
+static int
+find_path (const char *test,
+           double     *error)
+{
+  char  command[1024];
+  FILE *child;
+  int   length = 0;
+
+  *error = 0.0;
+  snprintf (command, sizeof (command), "%s --find-path", test);
+  child = popen (command, "r");
+  if (!child)
+    return 0;
+  if (fscanf (child, "%i %lf", &length, error) != 2)
+    length = 0;
+  pclose (child);
+  return length;
+}
+
+static int
+child_find_path (void)
+{
+  BablFishStats stats;
+  const Babl   *palette;
+  unsigned char indices[4] = { 0, 1, 2, 3 };
+  float         rgba[4 * 4];
+
+  babl_init ();
+  babl_fish_get_stats (babl_fish ("R'G'B'A u8", "Y float"), &stats);
+
+  /* the conversions of palettes are left out of the snapshot */
+  babl_new_palette (NULL, &palette, NULL);
+  babl_process (babl_fish (palette, babl_format ("RGBA float")),
+                indices, rgba, 4);
+  printf ("%i %a\n", stats.path_length, stats.error);
+  babl_exit ();
+  return 0;
+}
+
+/* the measurements written to the snapshot are restored by the next
+ * process, which finds the same path without adding to it, a snapshot
+ * from another version of babl is replaced, and of a snapshot from the
+ * same version only the conversions of extensions not loaded are kept
+ * besides the conversions babl has */
+int
+main (int    argc,
+      char **argv)
+{
+  static char first[MAX_SIZE];
+  static char second[MAX_SIZE];
+  FILE       *file;
+  double      error[2];
+  int         length[2];
+  int         OK = 1;
+
+  if (argc == 2 && !strcmp (argv[1], "--find-path"))
+    return child_find_path ();
+
+  remove (SNAPSHOT_FILE);
+  remove (COSTS_FILE);
+  putenv ("BABL_SNAPSHOT=" SNAPSHOT_FILE);
+  /* for the same path to be chosen every time */
+  putenv ("BABL_PATH_COSTS=" COSTS_FILE);
+
+  length[0] = find_path (argv[0], &error[0]);
+  if (length[0] < 1)
+    {
+      printf ("unable to find a path\n");
+      OK = 0;
+    }
+  if (!read_file (first) || strncmp (first, "babl-snapshot ", 14) ||
+      !strstr (first, "\nconversion "))
+    {
+      printf ("no measurements were written to %s\n", SNAPSHOT_FILE);
+      OK = 0;
+    }
+  if (strstr (first, "babl-int-"))
+    {
+      printf ("the conversions of a palette were written to %s\n",
+              SNAPSHOT_FILE);
+      OK = 0;
+    }
+
+  length[1] = find_path (argv[0], &error[1]);
+  read_file (second);
+  if (strcmp (first, second))
+    {
+      printf ("the snapshot changed without anything new to measure\n");
+      OK = 0;
+    }
+  if (length[0] != length[1] || error[0] != error[1])
+    {
+      printf ("expected the same path, got %i conversions with error %g "
+              "and %i with error %g\n",
+              length[0], error[0], length[1], error[1]);
+      OK = 0;
+    }
+
+  file = fopen (SNAPSHOT_FILE, "w");
+  if (file)
+    {
+      fprintf (file, "babl-snapshot 0\nconversion 0x1p+0 0 nonsense\n");
+      fclose (file);
+    }
+  find_path (argv[0], &error[1]);
+  read_file (second);
+  if (strncmp (first, second, strcspn (first, "\n") + 1) ||
+      !strstr (second, "\nconversion ") || strstr (second, "nonsense"))
+    {
+      printf ("expected a snapshot from elsewhere to be replaced\n");
+      OK = 0;
+    }
+
+  file = fopen (SNAPSHOT_FILE, "w");
+  if (file)
+    {
+      fprintf (file, "%.*s", (int) strcspn (first, "\n") + 1, first);
+      fprintf (file, "conversion 0x1p+0 0 BablBase 0: gone to nowhere\n"
+                     "conversion 0x1p+0 0 elsewhere.so 0: kept to there\n");
+      fclose (file);
+    }
+  find_path (argv[0], &error[1]);
+  read_file (second);
+  if (strstr (second, "gone to nowhere") ||
+      !strstr (second, "elsewhere.so 0: kept to there"))
+    {
+      printf ("expected only the conversions of extensions not loaded to "
+              "be kept\n");
+      OK = 0;
+    }
+  remove (SNAPSHOT_FILE);
+  remove (COSTS_FILE);
+
+  return !OK;
+}
@@ -0,0 +1,118 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <math.h>
+#include "babl-internal.h"
+
+#define PIXELS       4096
+#define TOLERANCE    0.5
+
+unsigned char source_buf [PIXELS * 3];
+float         float_source_buf [PIXELS * 3];
+float         reference_buf [PIXELS * 3];
+float         destination_buf [PIXELS * 3];
+
+/* with a tolerance this loose the interpolating fish is likely to be
+ * picked, it should still be close to the exact conversion.
+ */
+static int
+test (void)
+{
+  const Babl  *source      = babl_format ("R'G'B' u8");
+  const Babl  *destination = babl_format ("CIE Lab float");
+  unsigned int seed        = 1;
+  int          i;
+  int          OK          = 1;
+
+  for (i = 0; i < PIXELS * 3; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      source_buf[i] = (seed >> 16) & 0xff;
+    }
+
+  babl_process (babl_fish (source, destination),
+                source_buf, destination_buf, PIXELS);
+  babl_process (babl_fish_reference (source, destination),
+                source_buf, reference_buf, PIXELS);
+
+  for (i = 0; i < PIXELS * 3; i++)
+    {
+      if (fabs (destination_buf[i] - reference_buf[i]) > TOLERANCE)
+        {
+          babl_log ("%4i (%4i%%3=%i, %4i/3=%i) is %f should be %f",
+                    i, i, i % 3, i, i / 3, destination_buf[i], reference_buf[i]);
+          OK = 0;
+        }
+    }
+  if (!OK)
+    return -1;
+  return 0;
+}
+
+/* float pixels outside of the grid are converted exactly, not clamped */
+static int
+test_outside (void)
+{
+  const Babl  *source      = babl_format ("R'G'B' float");
+  const Babl  *destination = babl_format ("CIE Lab float");
+  unsigned int seed        = 1;
+  int          i;
+  int          OK          = 1;
+
+  for (i = 0; i < PIXELS * 3; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      float_source_buf[i] = ((seed >> 16) & 0xff) / 255.0f;
+      if (i % 7 == 0)
+        float_source_buf[i] = i % 2 ? 1.6f : -0.3f;
+    }
+
+  babl_process (babl_fish (source, destination),
+                float_source_buf, destination_buf, PIXELS);
+  babl_process (babl_fish_reference (source, destination),
+                float_source_buf, reference_buf, PIXELS);
+
+  for (i = 0; i < PIXELS * 3; i++)
+    {
+      if (fabs (destination_buf[i] - reference_buf[i]) > TOLERANCE)
+        {
+          babl_log ("%4i (%4i%%3=%i, %4i/3=%i) is %f should be %f",
+                    i, i, i % 3, i, i / 3, destination_buf[i], reference_buf[i]);
+          OK = 0;
+        }
+    }
+  if (!OK)
+    return -1;
+  return 0;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  putenv ("BABL_TOLERANCE=0.01");
+  babl_init ();
+  if (test ())
+    return -1;
+  if (test_outside ())
+    return -1;
+  babl_exit ();
+  return 0;
+}
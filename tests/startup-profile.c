@@ -0,0 +1,102 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+typedef struct
+{
+  int phases;
+  int bad;
+  int core;
+  int cie;
+  int formats;
+} Seen;
+
+static int
+check_phase (const BablStartupPhase *phase,
+             void                   *user_data)
+{
+  Seen *seen = user_data;
+  int   len  = strlen (phase->name);
+
+  seen->phases++;
+  if (phase->nsecs < 0 || phase->depth < 0 ||
+      phase->types < 0 || phase->components < 0 || phase->models < 0 ||
+      phase->formats < 0 || phase->conversions < 0)
+    {
+      printf ("%s has negative measurements\n", phase->name);
+      seen->bad++;
+    }
+  if (!strcmp (phase->name, "core") && phase->depth == 0)
+    seen->core++;
+  /* loaded at startup, or on demand by the lookup below */
+  if (len >= 6 && !strcmp (phase->name + len - 6, "CIE.so") &&
+      phase->models > 0)
+    seen->cie++;
+  seen->formats += phase->formats;
+  return 0;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Seen seen = { 0, };
+  int  OK   = 1;
+
+  setenv ("BABL_STARTUP_PROFILE", "1", 1);
+  babl_init ();
+
+  babl_format ("CIE Lab float");
+  babl_startup_profile_foreach (check_phase, &seen);
+
+  if (seen.bad)
+    OK = 0;
+  if (seen.core != 1)
+    {
+      printf ("expected one core phase, not %i\n", seen.core);
+      OK = 0;
+    }
+  if (seen.cie != 1)
+    {
+      printf ("expected the CIE extension to be recorded once, not %i\n",
+              seen.cie);
+      OK = 0;
+    }
+  if (seen.formats < 1)
+    {
+      printf ("expected formats to be registered\n");
+      OK = 0;
+    }
+
+  babl_exit ();
+
+  seen.phases = 0;
+  babl_startup_profile_foreach (check_phase, &seen);
+  if (seen.phases)
+    {
+      printf ("expected no phases after babl_exit\n");
+      OK = 0;
+    }
+
+  return !OK;
+}
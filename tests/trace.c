@@ -0,0 +1,97 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include "babl.h"
+
+#define PIXELS 64
+
+static long events[BABL_TRACE_REFERENCE_FALLBACK + 1];
+static long pixels_begin;
+static long pixels_end;
+
+static void
+trace (BablTraceEvent  event,
+       const Babl     *source,
+       const Babl     *destination,
+       long            count,
+       void           *user_data)
+{
+  events[event]++;
+  if (event == BABL_TRACE_PROCESS_BEGIN)
+    pixels_begin += count;
+  else if (event == BABL_TRACE_PROCESS_END)
+    pixels_end += count;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  unsigned short src[PIXELS * 3] = { 0, };
+  float          dst[PIXELS];
+  const Babl    *fish;
+  long           hits;
+  int            OK = 1;
+
+  babl_init ();
+
+  babl_set_trace_func (trace, NULL);
+
+  /* building a fish can look up other fishes, thus only the first lookup
+   * is known to miss */
+  fish = babl_fish ("R'G'B' u16", "Y float");
+  if (events[BABL_TRACE_FISH_MISS] < 1 ||
+      events[BABL_TRACE_PATH_SEARCH_BEGIN] < 1 ||
+      events[BABL_TRACE_PATH_SEARCH_BEGIN] != events[BABL_TRACE_PATH_SEARCH_END])
+    {
+      printf ("expected a miss and a path search on the first lookup\n");
+      OK = 0;
+    }
+
+  hits = events[BABL_TRACE_FISH_HIT] + events[BABL_TRACE_REFERENCE_FALLBACK];
+  if (babl_fish ("R'G'B' u16", "Y float") != fish ||
+      events[BABL_TRACE_FISH_HIT] + events[BABL_TRACE_REFERENCE_FALLBACK] != hits + 1)
+    {
+      printf ("expected a hit or a fallback on the second lookup\n");
+      OK = 0;
+    }
+
+  pixels_begin = pixels_end = 0;
+  babl_process (fish, src, dst, PIXELS);
+  babl_process (fish, src, dst, PIXELS);
+  if (pixels_begin != 2 * PIXELS || pixels_end != 2 * PIXELS)
+    {
+      printf ("expected %i pixels processed, got %li begun %li ended\n",
+              2 * PIXELS, pixels_begin, pixels_end);
+      OK = 0;
+    }
+
+  babl_set_trace_func (NULL, NULL);
+  babl_process (fish, src, dst, PIXELS);
+  if (pixels_begin != 2 * PIXELS)
+    {
+      printf ("traced after the trace function was unset\n");
+      OK = 0;
+    }
+
+  babl_exit ();
+
+  return !OK;
+}
@@ -0,0 +1,78 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include "babl-internal.h"
+
+/* the measurements are split between the threads, which find the buffers
+ * they share made, conversions measured are not measured again, and paths
+ * found afterwards are within the tolerance */
+int
+main (int    argc,
+      char **argv)
+{
+  BablFishStats stats;
+  int           measured;
+  int           measuring;
+  long          buffers;
+  int           OK = 1;
+
+  babl_init ();
+
+  measured = babl_warmup (4);
+  if (measured < 1)
+    {
+      printf ("expected conversions to be measured\n");
+      OK = 0;
+    }
+
+  babl_warmup_stats (&measuring, &buffers);
+  if (measuring < 2)
+    {
+      printf ("expected the conversions to be measured by several threads, "
+              "%i did\n", measuring);
+      OK = 0;
+    }
+  if (buffers != 0)
+    {
+      printf ("expected the buffers to be made before the threads start, "
+              "%li were made by them\n", buffers);
+      OK = 0;
+    }
+
+  measured = babl_warmup (4);
+  if (measured != 0)
+    {
+      printf ("expected nothing left to measure, %i were\n", measured);
+      OK = 0;
+    }
+
+  babl_fish_get_stats (babl_fish ("R'G'B'A u8", "Y float"), &stats);
+  if (strcmp (stats.kind, "BablFishPath") || stats.error > 0.000001)
+    {
+      printf ("expected a path within the tolerance, got a %s with "
+              "error %f\n", stats.kind, stats.error);
+      OK = 0;
+    }
+
+  babl_exit ();
+
+  return !OK;
+}
@@ -0,0 +1,542 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* babl-bench measures the throughput of fishes in megapixels per second,
+ * for a set of format pairs at several buffer sizes and thread counts.
+ * Results can be written as JSON, and compared against such a file from
+ * an earlier run to find regressions.
+ *
+ *   babl-bench [options] [source destination ...]
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl-internal.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define MAX_VALUES      16
+#define MAX_THREADS     256
+#define MAX_NAME_LEN    256
+
+typedef struct
+{
+  const Babl *fish;
+  const char *source;
+  long        n;
+  char       *destination;
+  long        end_ticks;
+  long        pixels;
+} BenchThread;
+
+typedef struct
+{
+  char   source[MAX_NAME_LEN];
+  char   destination[MAX_NAME_LEN];
+  long   pixels;
+  int    threads;
+  double mpps;
+} BenchResult;
+
+/* pixel counts keeping source and destination resident in the L1 cache,
+ * in the L2 cache and in main memory for most formats.
+ */
+static long   sizes[MAX_VALUES]   = { 512, 16384, 2097152 };
+static int    n_sizes             = 3;
+static long   threads[MAX_VALUES] = { 1 };
+static int    n_threads           = 1;
+static long   time_ms             = 100;
+static double threshold           = 0.1;
+
+static const char *default_pairs[] =
+{
+  "R'G'B'A u8",  "RGBA float",
+  "RGBA float",  "R'G'B'A u8",
+  "R'G'B' u8",   "R'G'B'A u8",
+  "R'G'B'A u8",  "R'G'B' u8",
+  "RGBA float",  "RaGaBaA float",
+  "RaGaBaA float", "RGBA float",
+  "R'G'B'A u16", "RGBA float",
+  "Y' u8",       "R'G'B'A u8",
+  "RGBA float",  "Y float",
+  "RGBA double", "R'G'B'A u8",
+  NULL
+};
+
+static BenchResult *results   = NULL;
+static int          n_results = 0;
+
+static void
+usage (void)
+{
+  printf ("usage: babl-bench [options] [source destination ...]\n"
+          "\n"
+          "Measures the throughput of babl fishes in megapixels per second.\n"
+          "\n"
+          "  --all              benchmark all pairs of registered formats\n"
+          "  --sizes N[,N...]   buffer sizes in pixels (default 512,16384,2097152)\n"
+          "  --threads N[,N...] numbers of threads to use (default 1)\n"
+          "  --time MS          time spent per measurement (default 100)\n"
+          "  --output FILE      write the results as JSON to FILE\n"
+          "  --baseline FILE    compare with the results of an earlier run\n"
+          "  --threshold F      relative slowdown reported as regression (default 0.1)\n");
+}
+
+static int
+parse_list (const char *str,
+            long       *values)
+{
+  int count = 0;
+
+  while (str && *str && count < MAX_VALUES)
+    {
+      char *end;
+      long  value = strtol (str, &end, 10);
+
+      if (end == str || value <= 0)
+        {
+          fprintf (stderr, "babl-bench: invalid list '%s'\n", str);
+          exit (2);
+        }
+      values[count++] = value;
+      str = *end == ',' ? end + 1 : NULL;
+    }
+  return count;
+}
+
+/* a deterministic buffer of in gamut pixels in the source format, random
+ * bytes would contain NaNs and denormals for float formats.
+ */
+static char *
+source_buffer (const Babl *format,
+               long        n)
+{
+  const Babl   *rgba_double = babl_format ("RGBA double");
+  double       *rgba        = babl_malloc (n * 4 * sizeof (double));
+  char         *buffer      = babl_malloc (n * babl_format_get_bytes_per_pixel (format));
+  unsigned int  seed        = 1;
+  long          i;
+
+  for (i = 0; i < n * 4; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      rgba[i] = ((seed >> 16) & 0x7fff) / 32767.0;
+    }
+  babl_process (babl_fish (rgba_double, format), rgba, buffer, n);
+  babl_free (rgba);
+  return buffer;
+}
+
+static void *
+bench_thread (void *data)
+{
+  BenchThread *bt      = data;
+  /* tiny buffers are converted repeatedly between reading the clock, to
+   * measure the conversions rather than the clock */
+  long         repeats = bt->n < 4096 ? 4096 / bt->n : 1;
+  long         i;
+
+  do
+    {
+      for (i = 0; i < repeats; i++)
+        babl_process (bt->fish, bt->source, bt->destination, bt->n);
+      bt->pixels += bt->n * repeats;
+    }
+  while (babl_ticks () < bt->end_ticks);
+  return NULL;
+}
+
+/* runs the fish over n pixels split between n_threads threads for about
+ * time_ms, and returns the throughput in megapixels per second.
+ */
+static double
+measure (const Babl *fish,
+         const char *source,
+         char       *destination,
+         long        n,
+         int         n_threads)
+{
+  int          src_bpp = babl_format_get_bytes_per_pixel (fish->fish.source);
+  int          dst_bpp = babl_format_get_bytes_per_pixel (fish->fish.destination);
+  BenchThread  bt[MAX_THREADS];
+  long         chunk;
+  long         start;
+  long         pixels = 0;
+  int          i;
+
+#ifdef _WIN32
+  n_threads = 1;
+#endif
+  if (n_threads > MAX_THREADS)
+    n_threads = MAX_THREADS;
+  if (n_threads > n)
+    n_threads = n;
+  chunk = n / n_threads;
+
+  /* warm up caches and lazily built tables */
+  babl_process (fish, source, destination, n);
+
+  start = babl_ticks ();
+  for (i = 0; i < n_threads; i++)
+    {
+      bt[i].fish        = fish;
+      bt[i].source      = source + i * chunk * src_bpp;
+      bt[i].destination = destination + i * chunk * dst_bpp;
+      bt[i].n           = i == n_threads - 1 ? n - i * chunk : chunk;
+      bt[i].end_ticks   = start + time_ms * 1000;
+      bt[i].pixels      = 0;
+    }
+
+#ifndef _WIN32
+  if (n_threads > 1)
+    {
+      pthread_t thread[MAX_THREADS];
+
+      for (i = 0; i < n_threads; i++)
+        pthread_create (&thread[i], NULL, bench_thread, &bt[i]);
+      for (i = 0; i < n_threads; i++)
+        pthread_join (thread[i], NULL);
+    }
+  else
+#endif
+    bench_thread (&bt[0]);
+
+  for (i = 0; i < n_threads; i++)
+    pixels += bt[i].pixels;
+  return pixels / (double) (babl_ticks () - start);
+}
+
+static void
+add_result (const char *source,
+            const char *destination,
+            long        pixels,
+            int         n_threads,
+            double      mpps)
+{
+  BenchResult *result;
+
+  results = realloc (results, (n_results + 1) * sizeof (BenchResult));
+  result  = &results[n_results++];
+  snprintf (result->source, MAX_NAME_LEN, "%s", source);
+  snprintf (result->destination, MAX_NAME_LEN, "%s", destination);
+  result->pixels  = pixels;
+  result->threads = n_threads;
+  result->mpps    = mpps;
+}
+
+static void
+bench_pair (const Babl *source,
+            const Babl *destination)
+{
+  const Babl *fish = babl_fish (source, destination);
+  long        max_size = 0;
+  char       *src;
+  char       *dst;
+  int         s, t;
+
+  for (s = 0; s < n_sizes; s++)
+    if (sizes[s] > max_size)
+      max_size = sizes[s];
+
+  src = source_buffer (source, max_size);
+  dst = babl_malloc (max_size * babl_format_get_bytes_per_pixel (destination));
+
+  for (s = 0; s < n_sizes; s++)
+    for (t = 0; t < n_threads; t++)
+      {
+        double mpps = measure (fish, src, dst, sizes[s], threads[t]);
+
+        printf ("%-24s %-24s %9li px %3li thr %10.2f MP/s\n",
+                babl_get_name (source), babl_get_name (destination),
+                sizes[s], threads[t], mpps);
+        fflush (stdout);
+        add_result (babl_get_name (source), babl_get_name (destination),
+                    sizes[s], threads[t], mpps);
+      }
+
+  babl_free (src);
+  babl_free (dst);
+}
+
+static const Babl **all_formats   = NULL;
+static int          n_all_formats = 0;
+
+static int
+collect_format (Babl *babl,
+                void *data)
+{
+  if (babl_format_is_palette (babl) || babl->format.planar)
+    return 0;
+  all_formats = realloc (all_formats, (n_all_formats + 1) * sizeof (Babl *));
+  all_formats[n_all_formats++] = babl;
+  return 0;
+}
+
+static void
+write_json_string (FILE       *file,
+                   const char *str)
+{
+  fputc ('"', file);
+  for (; *str; str++)
+    {
+      if (*str == '"' || *str == '\\')
+        fputc ('\\', file);
+      fputc (*str, file);
+    }
+  fputc ('"', file);
+}
+
+/* results are written one per line, which is what read_results expects */
+static void
+write_results (const char *path)
+{
+  FILE *file = fopen (path, "w");
+  int   i;
+
+  if (!file)
+    {
+      fprintf (stderr, "babl-bench: unable to write '%s'\n", path);
+      exit (2);
+    }
+
+  fprintf (file, "{\n  \"babl-version\": \"%i.%i.%i\",\n  \"results\": [\n",
+           BABL_MAJOR_VERSION, BABL_MINOR_VERSION, BABL_MICRO_VERSION);
+  for (i = 0; i < n_results; i++)
+    {
+      fprintf (file, "    {\"source\": ");
+      write_json_string (file, results[i].source);
+      fprintf (file, ", \"destination\": ");
+      write_json_string (file, results[i].destination);
+      fprintf (file, ", \"pixels\": %li, \"threads\": %i, \"mpps\": %.3f}%s\n",
+               results[i].pixels, results[i].threads, results[i].mpps,
+               i < n_results - 1 ? "," : "");
+    }
+  fprintf (file, "  ]\n}\n");
+  fclose (file);
+}
+
+static int
+json_string_field (const char *line,
+                   const char *key,
+                   char       *value)
+{
+  char        pattern[64];
+  const char *p;
+  int         len = 0;
+
+  snprintf (pattern, sizeof (pattern), "\"%s\": \"", key);
+  p = strstr (line, pattern);
+  if (!p)
+    return 0;
+  for (p += strlen (pattern); *p && *p != '"' && len < MAX_NAME_LEN - 1; p++)
+    {
+      if (*p == '\\' && p[1])
+        p++;
+      value[len++] = *p;
+    }
+  value[len] = '\0';
+  return 1;
+}
+
+static int
+json_number_field (const char *line,
+                   const char *key,
+                   double     *value)
+{
+  char        pattern[64];
+  const char *p;
+
+  snprintf (pattern, sizeof (pattern), "\"%s\": ", key);
+  p = strstr (line, pattern);
+  if (!p)
+    return 0;
+  *value = atof (p + strlen (pattern));
+  return 1;
+}
+
+static BenchResult *
+read_results (const char *path,
+              int        *count)
+{
+  FILE        *file = fopen (path, "r");
+  BenchResult *baseline = NULL;
+  char         line[1024];
+
+  *count = 0;
+  if (!file)
+    {
+      fprintf (stderr, "babl-bench: unable to read '%s'\n", path);
+      exit (2);
+    }
+
+  while (fgets (line, sizeof (line), file))
+    {
+      BenchResult result;
+      double      pixels, threads;
+
+      if (json_string_field (line, "source", result.source) &&
+          json_string_field (line, "destination", result.destination) &&
+          json_number_field (line, "pixels", &pixels) &&
+          json_number_field (line, "threads", &threads) &&
+          json_number_field (line, "mpps", &result.mpps))
+        {
+          result.pixels  = pixels;
+          result.threads = threads;
+          baseline = realloc (baseline, (*count + 1) * sizeof (BenchResult));
+          baseline[(*count)++] = result;
+        }
+    }
+  fclose (file);
+  return baseline;
+}
+
+/* prints the change of every result also present in the baseline, and
+ * returns the number of regressions.
+ */
+static int
+compare_results (const char *path)
+{
+  int          n_baseline;
+  BenchResult *baseline = read_results (path, &n_baseline);
+  int          regressions = 0;
+  int          i, j;
+
+  printf ("\ncompared to %s:\n", path);
+  for (i = 0; i < n_results; i++)
+    for (j = 0; j < n_baseline; j++)
+      if (!strcmp (results[i].source, baseline[j].source) &&
+          !strcmp (results[i].destination, baseline[j].destination) &&
+          results[i].pixels == baseline[j].pixels &&
+          results[i].threads == baseline[j].threads &&
+          baseline[j].mpps > 0.0)
+        {
+          double change = results[i].mpps / baseline[j].mpps - 1.0;
+          int    regressed = change < -threshold;
+
+          printf ("%-24s %-24s %9li px %3i thr %+7.1f%%%s\n",
+                  results[i].source, results[i].destination,
+                  results[i].pixels, results[i].threads, change * 100.0,
+                  regressed ? "  REGRESSION" : "");
+          regressions += regressed;
+          break;
+        }
+
+  free (baseline);
+  printf ("%i regression%s\n", regressions, regressions == 1 ? "" : "s");
+  return regressions;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  const char  *output   = NULL;
+  const char  *baseline = NULL;
+  const char **pairs;
+  int          n_pairs  = 0;
+  int          all      = 0;
+  int          ret      = 0;
+  int          i;
+
+  pairs = malloc (argc * sizeof (char *));
+
+  for (i = 1; i < argc; i++)
+    {
+      const char *arg = argv[i];
+      const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+
+      if (!strcmp (arg, "--help") || !strcmp (arg, "-h"))
+        {
+          usage ();
+          return 0;
+        }
+      else if (!strcmp (arg, "--all"))
+        all = 1;
+      else if (next && !strcmp (arg, "--sizes"))
+        {
+          long values[MAX_VALUES];
+          int  j;
+
+          n_sizes = parse_list (argv[++i], values);
+          for (j = 0; j < n_sizes; j++)
+            sizes[j] = values[j];
+        }
+      else if (next && !strcmp (arg, "--threads"))
+        n_threads = parse_list (argv[++i], threads);
+      else if (next && !strcmp (arg, "--time"))
+        time_ms = atol (argv[++i]);
+      else if (next && !strcmp (arg, "--output"))
+        output = argv[++i];
+      else if (next && !strcmp (arg, "--baseline"))
+        baseline = argv[++i];
+      else if (next && !strcmp (arg, "--threshold"))
+        threshold = atof (argv[++i]);
+      else if (arg[0] == '-' && arg[1] == '-')
+        {
+          usage ();
+          return 2;
+        }
+      else
+        pairs[n_pairs++] = arg;
+    }
+
+  if (n_pairs % 2)
+    {
+      fprintf (stderr, "babl-bench: formats have to be given in pairs\n");
+      return 2;
+    }
+
+  babl_init ();
+
+  if (all)
+    {
+      int s, d;
+
+      babl_format_class_for_each (collect_format, NULL);
+      for (s = 0; s < n_all_formats; s++)
+        for (d = 0; d < n_all_formats; d++)
+          if (s != d)
+            bench_pair (all_formats[s], all_formats[d]);
+      free (all_formats);
+    }
+  else if (n_pairs)
+    {
+      for (i = 0; i < n_pairs; i += 2)
+        bench_pair (babl_format (pairs[i]), babl_format (pairs[i + 1]));
+    }
+  else
+    {
+      for (i = 0; default_pairs[i]; i += 2)
+        bench_pair (babl_format (default_pairs[i]),
+                    babl_format (default_pairs[i + 1]));
+    }
+
+  if (output)
+    write_results (output);
+  if (baseline && compare_results (baseline))
+    ret = 1;
+
+  free (results);
+  free (pairs);
+  babl_exit ();
+  return ret;
+}
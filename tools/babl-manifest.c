@@ -0,0 +1,54 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* babl-manifest loads every extension in the given directory list, or in
+ * BABL_PATH, and writes a manifest next to each of them listing what it
+ * registers, letting babl_init () defer loading them until needed.
+ *
+ *   babl-manifest [directory list]
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl.h"
+
+int
+main (int    argc,
+      char **argv)
+{
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+    {
+      fprintf (stderr, "usage: %s [directory list]\n", argv[0]);
+      return 1;
+    }
+  if (argc == 2)
+    {
+      char *env = malloc (strlen ("BABL_PATH=") + strlen (argv[1]) + 1);
+
+      strcpy (env, "BABL_PATH=");
+      strcat (env, argv[1]);
+      putenv (env);
+    }
+  putenv ("BABL_MANIFESTS=write");
+
+  babl_init ();
+  babl_exit ();
+  return 0;
+}
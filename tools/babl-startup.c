@@ -0,0 +1,104 @@
+/* babl - dynamically extendable universal pixel conversion library.
+ * Copyright (C) 2005, Øyvind Kolås.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this library; if not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/* babl-startup prints where the time of babl_init () goes, phase by phase
+ * and extension by extension, with what each registered. Fishes created
+ * for the given pairs of formats afterwards include the extensions they
+ * load on demand.
+ *
+ *   babl-startup [source destination ...]
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "babl-internal.h"
+
+typedef struct
+{
+  long long total;
+  int       types;
+  int       components;
+  int       models;
+  int       formats;
+  int       conversions;
+} StartupTotal;
+
+static int
+print_phase (const BablStartupPhase *phase,
+             void                   *user_data)
+{
+  StartupTotal *total = user_data;
+  const char   *name  = phase->name;
+  const char   *slash = strrchr (name, '/');
+
+  /* extensions by their file name, the directories are long and shared */
+  if (slash)
+    name = slash + 1;
+
+  printf ("%*s%-*s %9.3f %7i %7i %7i %7i %7i\n",
+          phase->depth * 2, "", 32 - phase->depth * 2, name,
+          phase->nsecs / 1000000.0,
+          phase->types, phase->components, phase->models,
+          phase->formats, phase->conversions);
+
+  total->total       += phase->nsecs;
+  total->types       += phase->types;
+  total->components  += phase->components;
+  total->models      += phase->models;
+  total->formats     += phase->formats;
+  total->conversions += phase->conversions;
+  return 0;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  StartupTotal total = { 0, };
+  long long    ticks;
+  int          i;
+
+  if (argc % 2 == 0)
+    {
+      fprintf (stderr, "usage: %s [source destination ...]\n", argv[0]);
+      return 1;
+    }
+
+  setenv ("BABL_STARTUP_PROFILE", "1", 1);
+
+  ticks = babl_nanoticks ();
+  babl_init ();
+  ticks = babl_nanoticks () - ticks;
+
+  for (i = 1; i + 1 < argc; i += 2)
+    babl_fish (babl_format (argv[i]), babl_format (argv[i + 1]));
+
+  printf ("%-32s %9s %7s %7s %7s %7s %7s\n",
+          "phase", "ms", "types", "comps", "models", "formats", "convs");
+  babl_startup_profile_foreach (print_phase, &total);
+  printf ("%-32s %9.3f %7i %7i %7i %7i %7i\n", "total",
+          total.total / 1000000.0,
+          total.types, total.components, total.models,
+          total.formats, total.conversions);
+  printf ("babl_init () took %.3f ms\n", ticks / 1000000.0);
+
+  babl_exit ();
+  return 0;
+}